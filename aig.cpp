@@ -0,0 +1,241 @@
+#include "aig.h"
+
+#include <algorithm>
+
+Aig::Aig()
+    : nodes{ { NoLit, NoLit } }
+{
+}
+
+Aig::Lit Aig::input(AtomId atom)
+{
+    const auto [it, inserted] = inputs.try_emplace(atom, static_cast<Lit>(2 * nodes.size()));
+    if (inserted) {
+        nodes.push_back({ NoLit, atom });
+    }
+    return it->second;
+}
+
+Aig::Lit Aig::conjoin(Lit a, Lit b, bool rewrite)
+{
+    if (a == False || b == False || a == neg(b)) {
+        return False;
+    } else if (a == True || a == b) {
+        return b;
+    } else if (b == True) {
+        return a;
+    }
+
+    Lit out;
+    if (rewrite && (two_level(a, b, false, out) || two_level(b, a, true, out))) {
+        return out;
+    }
+
+    const auto key         = (static_cast<std::uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+    const auto [it, added] = table.try_emplace(key, static_cast<Lit>(2 * nodes.size()));
+    if (added) {
+        nodes.push_back({ a, b });
+    }
+    return it->second;
+}
+
+// Rewrites a ∧ b for a gate a, written b ∧ a if swapped. The substitutions only fold
+// constants and hash so that rewriting stays local, their operands keep the written order.
+bool Aig::two_level(Lit a, Lit b, bool swapped, Lit &out)
+{
+    if (!is_gate(a)) {
+        return false;
+    }
+    const auto a0 = child(a, 0);
+    const auto a1 = child(a, 1);
+
+    const auto substitute = [&](Lit for_a, Lit for_b) { return swapped ? conjoin(for_b, for_a, false) : conjoin(for_a, for_b, false); };
+
+    if (!(a & 1)) {
+        if (b == neg(a0) || b == neg(a1)) {
+            out = False; // (x ∧ y) ∧ ¬x
+        } else if (b == a0 || b == a1) {
+            out = a; // (x ∧ y) ∧ x
+        } else if (is_gate(b) && !(b & 1)) {
+            const auto b0 = child(b, 0);
+            const auto b1 = child(b, 1);
+            if (b0 == neg(a0) || b0 == neg(a1) || b1 == neg(a0) || b1 == neg(a1)) {
+                out = False; // (x ∧ y) ∧ (¬x ∧ z)
+            } else {
+                return false;
+            }
+        } else if (is_gate(b)) {
+            const auto b0 = child(b, 0);
+            const auto b1 = child(b, 1);
+            if (b0 == neg(a0) || b0 == neg(a1) || b1 == neg(a0) || b1 == neg(a1)) {
+                out = a; // (x ∧ y) ∧ ¬(¬x ∧ z)
+            } else if (b0 == a0 || b0 == a1) {
+                out = substitute(a, neg(b1)); // (x ∧ y) ∧ ¬(x ∧ z) = (x ∧ y) ∧ ¬z
+            } else if (b1 == a0 || b1 == a1) {
+                out = substitute(a, neg(b0));
+            } else {
+                return false;
+            }
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    if (b == neg(a0) || b == neg(a1)) {
+        out = b; // ¬(x ∧ y) ∧ ¬x
+    } else if (b == a0) {
+        out = substitute(neg(a1), b); // ¬(x ∧ y) ∧ x = ¬y ∧ x
+    } else if (b == a1) {
+        out = substitute(neg(a0), b);
+    } else if (is_gate(b) && (b & 1)) {
+        // ¬(x ∧ y) ∧ ¬(x ∧ ¬y) = ¬x
+        const auto b0 = child(b, 0);
+        const auto b1 = child(b, 1);
+        if ((a0 == b0 && a1 == neg(b1)) || (a0 == b1 && a1 == neg(b0))) {
+            out = neg(a0);
+        } else if ((a1 == b0 && a0 == neg(b1)) || (a1 == b1 && a0 == neg(b0))) {
+            out = neg(a1);
+        } else {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+Aig::Lit Aig::lower(const ExpressionStore &store, ExprId e)
+{
+    std::vector<Lit> lits(store.size(), NoLit);
+
+    Traversal<ExprId> traversal;
+    traversal.run(
+        e,
+        [&](ExprId e, const auto &push) {
+            if (lits[e] != NoLit) {
+                return false;
+            }
+            const auto &node = store[e];
+            if (node.binary() || node.op == Expression::Neg) {
+                push(node.lhs);
+            }
+            if (node.binary()) {
+                push(node.rhs);
+            }
+            return true;
+        },
+        [&](ExprId e) {
+            const auto &node = store[e];
+            const auto  l    = node.binary() || node.op == Expression::Neg ? lits[node.lhs] : NoLit;
+            const auto  r    = node.binary() ? lits[node.rhs] : NoLit;
+            switch (node.op) {
+            case Expression::And:
+                lits[e] = conjoin(l, r);
+                break;
+            case Expression::Or:
+                lits[e] = disjoin(l, r);
+                break;
+            case Expression::Impl:
+                lits[e] = neg(conjoin(l, neg(r)));
+                break;
+            case Expression::BiImpl:
+                lits[e] = conjoin(neg(conjoin(l, neg(r))), neg(conjoin(neg(l), r)));
+                break;
+            case Expression::Neg:
+                lits[e] = neg(l);
+                break;
+            case Expression::Constant:
+                lits[e] = node.lhs ? True : False;
+                break;
+            case Expression::Pred:
+                lits[e] = input(node.lhs);
+                break;
+            }
+        });
+    return lits[e];
+}
+
+Aig::Shape Aig::shape(Lit l) const
+{
+    if (l < 2) {
+        return { Expression::Constant, l, NoLit };
+    } else if (!is_gate(l)) {
+        return (l & 1) ? Shape{ Expression::Neg, neg(l), NoLit } : Shape{ Expression::Pred, l, NoLit };
+    }
+
+    const auto a = child(l, 0);
+    const auto b = child(l, 1);
+
+    // ¬(x ∧ y) ∧ ¬(¬x ∧ ¬y) is x ↔ ¬y, its negation x ↔ y
+    if ((a & 1) && (b & 1) && is_gate(a) && is_gate(b)) {
+        const auto x = child(a, 0);
+        const auto y = child(a, 1);
+        if ((child(b, 0) == neg(x) && child(b, 1) == neg(y)) || (child(b, 0) == neg(y) && child(b, 1) == neg(x))) {
+            Lit lhs = x, rhs = (l & 1) ? y : neg(y);
+            if ((lhs & 1) && (rhs & 1)) {
+                lhs = neg(lhs);
+                rhs = neg(rhs);
+            }
+            return { Expression::BiImpl, lhs, rhs };
+        }
+    }
+
+    // The negation of a conjunction with a negated operand comes back as a disjunction or
+    // an implication, so ¬(x ∧ ¬y) is the rest of a chain of disjunctions if x is one
+    const auto disjunction = [&](Lit x) { return is_gate(x) && !(x & 1) && ((child(x, 0) & 1) || (child(x, 1) & 1)); };
+
+    if (!(l & 1)) {
+        return { Expression::And, a, b };
+    } else if ((a & 1) && (b & 1)) {
+        return { Expression::Or, neg(a), neg(b) };
+    } else if (b & 1) {
+        if (disjunction(a)) {
+            return { Expression::Or, neg(a), neg(b) };
+        }
+        return { Expression::Impl, a, neg(b) };
+    } else if (a & 1) {
+        return { Expression::Or, neg(a), neg(b) }; // ¬(¬x ∧ y) as x ∨ ¬y keeps the order
+    }
+    return { Expression::Neg, neg(l), NoLit };
+}
+
+ExprId Aig::raise(ExpressionStore &store, Lit l)
+{
+    raised.resize(2 * nodes.size(), NoExpr);
+
+    Traversal<Lit> traversal;
+    traversal.run(
+        l,
+        [&](Lit l, const auto &push) {
+            if (raised[l] != NoExpr) {
+                return false;
+            }
+            const auto s = shape(l);
+            if (s.op == Expression::Neg || s.op <= Expression::BiImpl) {
+                push(s.lhs);
+            }
+            if (s.op <= Expression::BiImpl) {
+                push(s.rhs);
+            }
+            return true;
+        },
+        [&](Lit l) {
+            const auto s = shape(l);
+            switch (s.op) {
+            case Expression::Constant:
+                raised[l] = store.constant(l == True);
+                break;
+            case Expression::Pred:
+                raised[l] = store.pred(nodes[l >> 1].rhs);
+                break;
+            case Expression::Neg:
+                raised[l] = store.neg(raised[s.lhs]);
+                break;
+            default:
+                raised[l] = store.binary(s.op, raised[s.lhs], raised[s.rhs]);
+                break;
+            }
+        });
+    return raised[l];
+}
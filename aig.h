@@ -0,0 +1,62 @@
+#pragma once
+#include "ast.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// And-Inverter Graph. Every node is the conjunction of two literals, a literal is twice a
+// node's index plus one if it is negated. Node 0 is ff, so literal 0 is ff and 1 is tt.
+//
+// conjoin() hashes nodes structurally, also with their operands swapped, folds constants
+// and applies the local two-level rewrites of Brummayer and Biere, "Local Two-Level
+// And-Inverter Graph Minimization without Blowup" (2006): contradiction, idempotence,
+// subsumption, substitution and resolution. None of them creates more than one node.
+class Aig {
+public:
+    using Lit = std::uint32_t;
+
+    static constexpr Lit False = 0;
+    static constexpr Lit True  = 1;
+    static constexpr Lit NoLit = UINT32_MAX;
+
+    static Lit neg(Lit l) { return l ^ 1; }
+
+    Aig();
+
+    Lit input(AtomId atom);
+    Lit conjoin(Lit a, Lit b) { return conjoin(a, b, true); }
+    Lit disjoin(Lit a, Lit b) { return neg(conjoin(neg(a), neg(b))); }
+
+    // Literal equivalent to e, every connective is lowered to conjunctions and negations
+    Lit lower(const ExpressionStore &store, ExprId e);
+
+    // Expression for l. Negated conjunctions come back as disjunctions and implications
+    // where that saves negations, the two conjunctions of an equivalence as one.
+    ExprId raise(ExpressionStore &store, Lit l);
+
+    std::size_t gates() const { return nodes.size() - 1 - inputs.size(); }
+
+private:
+    struct Node {
+        Lit lhs, rhs; // NoLit and the atom for inputs
+    };
+
+    bool is_gate(Lit l) const { return l >= 2 && nodes[l >> 1].lhs != NoLit; }
+    Lit  child(Lit l, int i) const { return i ? nodes[l >> 1].rhs : nodes[l >> 1].lhs; }
+
+    Lit  conjoin(Lit a, Lit b, bool rewrite);
+    bool two_level(Lit a, Lit b, bool swapped, Lit &out);
+
+    // Operator and operands raise() uses for l
+    struct Shape {
+        Expression::Type op;
+        Lit              lhs, rhs;
+    };
+    Shape shape(Lit l) const;
+
+    std::vector<Node>                      nodes;
+    std::unordered_map<std::uint64_t, Lit> table; // unordered operand pair to gate
+    std::unordered_map<AtomId, Lit>        inputs;
+    std::vector<ExprId>                    raised; // indexed by literal
+};
@@ -0,0 +1,63 @@
+#include "profile.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef SATSOLVER_COUNT_ALLOCATIONS
+// Replaces the global allocation functions of every executable linking this file, see
+// Profiler::allocated(). Each allocation costs a branch while counting is off. All of them end
+// in malloc and free, the delete overloads only differ in what they are told about the block.
+//
+// A file of its own: inlined into code that allocates, GCC pairs the free() here with the
+// operator new and warns about a mismatch.
+static void *allocate(std::size_t size, std::size_t alignment = 0)
+{
+    Profiler::global().allocated();
+    size = size ? size : 1;
+    if (alignment > alignof(std::max_align_t)) {
+        return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+    return std::malloc(size);
+}
+
+void *operator new(std::size_t size)
+{
+    if (void *p = allocate(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (void *p = allocate(size, static_cast<std::size_t>(alignment))) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size) { return operator new(size); }
+void *operator new[](std::size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { operator delete(p); }
+void operator delete(void *p, std::align_val_t) noexcept { operator delete(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { operator delete(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { operator delete(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { operator delete(p); }
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete[](void *p, std::size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { operator delete(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { operator delete(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { operator delete(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { operator delete(p); }
+#endif
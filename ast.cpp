@@ -1,160 +1,595 @@
 #include "ast.h"
+#include "aig.h"
+#include "bdd.h"
+#include "clauses.h"
+#include "cnf.h"
+#include "counter.h"
+#include "dimacs.h"
+#include "incremental.h"
+#include "localsearch.h"
+#include "miter.h"
+#include "portfolio.h"
+#include "preprocess.h"
+#include "profile.h"
+#include "program.h"
+#include "proof.h"
+#include "solver.h"
+#include "truthtable.h"
 
 #include <algorithm>
+#include <chrono>
+#include <unordered_set>
 
-template<typename T>
-auto cartesian(const std::list<std::list<T>> &input)
+static std::size_t hash(const Expression &node)
 {
-    std::list<std::list<T>> output = { {} };
-
-    for (auto &&u : input) {
-        std::list<std::list<T>> r;
-        for (auto &&x : output) {
-            for (auto &&y : u) {
-                r.push_back(x);
-                r.back().push_back(y);
-            }
+    auto h = ((static_cast<std::uint64_t>(node.lhs) << 32) | node.rhs) ^ (static_cast<std::uint64_t>(node.op) << 61);
+    h *= 0x9E3779B97F4A7C15ull;
+    return static_cast<std::size_t>(h ^ (h >> 32));
+}
+
+ExprId ExpressionStore::add(Expression node)
+{
+    if (2 * (nodes.size() + 1) > table.size()) {
+        grow();
+    }
+
+    const auto mask = table.size() - 1;
+    for (auto i = hash(node) & mask;; i = (i + 1) & mask) {
+        if (table[i] == NoExpr) {
+            table[i] = static_cast<ExprId>(nodes.size());
+            nodes.push_back(node);
+            return table[i];
+        }
+        if (nodes[table[i]] == node) {
+            return table[i];
         }
-        output = std::move(r);
     }
+}
 
-    return output;
+void ExpressionStore::grow()
+{
+    table.assign(table.empty() ? 64 : 2 * table.size(), NoExpr);
+    const auto mask = table.size() - 1;
+    for (ExprId e = 0; e < nodes.size(); e++) {
+        auto i = hash(nodes[e]) & mask;
+        while (table[i] != NoExpr) {
+            i = (i + 1) & mask;
+        }
+        table[i] = e;
+    }
+}
+
+// Binary operators as printed, indexed by Expression::Type
+static const char *const connectives[] = { " ∧ ", " ∨ ", " → ", " ↔ " };
+
+int ExpressionStore::print(ExprId e, FILE *out) const
+{
+    // A subexpression or the text that closes one, widths count connectives as one column
+    struct Piece {
+        ExprId      e;
+        const char *text;
+        int         width;
+    };
+
+    int              width = 0;
+    Traversal<Piece> traversal;
+    traversal.run(
+        { e, nullptr, 0 },
+        [&](const Piece &piece, const auto &push) {
+            if (piece.text) {
+                fprintf(out, "%s", piece.text);
+                width += piece.width;
+                return false;
+            }
+            const auto &node = nodes[piece.e];
+            switch (node.op) {
+            case Expression::Neg:
+                fprintf(out, "(¬");
+                width += 2;
+                push({ node.lhs, nullptr, 0 });
+                push({ NoExpr, ")", 1 });
+                break;
+            case Expression::Constant:
+                fprintf(out, "%s", node.lhs ? "tt" : "ff");
+                width += 2;
+                break;
+            case Expression::Pred:
+                fprintf(out, "%s", name(node.lhs).c_str());
+                width += name(node.lhs).length();
+                break;
+            default:
+                fprintf(out, "(");
+                width += 1;
+                push({ node.lhs, nullptr, 0 });
+                push({ NoExpr, connectives[node.op], 3 });
+                push({ node.rhs, nullptr, 0 });
+                push({ NoExpr, ")", 1 });
+                break;
+            }
+            return false;
+        },
+        [](const Piece &) {});
+    return width;
 }
 
-Statement::Statement()
-    : type(Expr)
+const std::vector<AtomId> &ExpressionStore::atoms(ExprId e) const
 {
+    if (const auto it = atomsets.find(e); it != end(atomsets)) {
+        return it->second;
+    }
+
+    std::vector<AtomId>        ats;
+    std::unordered_set<ExprId> seen;
+    visit(e, [&](ExprId id, const Expression &node) {
+        if (!seen.insert(id).second) {
+            return false;
+        }
+        if (node.op == Expression::Pred) {
+            ats.push_back(node.lhs);
+        }
+        return true;
+    });
+    std::sort(begin(ats), end(ats));
+    ats.erase(std::unique(begin(ats), end(ats)), end(ats));
+    return atomsets[e] = std::move(ats);
+}
+
+std::pair<std::size_t, std::size_t> ExpressionStore::shape(ExprId e) const
+{
+    std::vector<ExprId>        reached;
+    std::unordered_set<ExprId> seen;
+    visit(e, [&](ExprId id, const Expression &) {
+        if (!seen.insert(id).second) {
+            return false;
+        }
+        reached.push_back(id);
+        return true;
+    });
+
+    // Children have smaller ids, so their depth is known when their parents get to it
+    std::sort(begin(reached), end(reached));
+    std::unordered_map<ExprId, std::size_t> depth;
+    for (const auto id : reached) {
+        const auto &node = nodes[id];
+        std::size_t d    = 0;
+        if (node.binary()) {
+            d = std::max(depth[node.lhs], depth[node.rhs]);
+        } else if (node.op == Expression::Neg) {
+            d = depth[node.lhs];
+        }
+        depth[id] = d + 1;
+    }
+    return { reached.size(), depth[e] };
+}
+
+std::vector<ExprId> ExpressionStore::childs(ExprId e) const
+{
+    const auto &node = nodes[e];
+    if (node.binary()) {
+        return { node.lhs, node.rhs };
+    } else if (node.op == Expression::Neg) {
+        return { node.lhs };
+    }
+    return {};
 }
 
-Statement::Statement(std::shared_ptr<Expression> other, Type type)
-    : type(type)
-    , other(std::move(other))
+Statement::Statement(ExpressionStore &store, ExprId other, Type type)
+    : store(&store)
+    , type(type)
+    , other(other)
 {
-    this->other->update_parents();
 }
 
-Statement::Statement(const std::string &pred, std::shared_ptr<Expression> other)
-    : type(Set)
+Statement::Statement(ExpressionStore &store, AtomId pred, ExprId other)
+    : store(&store)
+    , type(Set)
     , pred(pred)
-    , other(std::move(other))
+    , other(other)
+{
+}
+
+Statement::Statement(ExpressionStore &store, ExprId other, std::vector<AtomId> projection)
+    : store(&store)
+    , type(PrintCount)
+    , projection(std::move(projection))
+    , other(other)
+{
+}
+
+Statement::Statement(ExpressionStore &store, ExprId other, ExprId rhs, Type type)
+    : store(&store)
+    , type(type)
+    , other(other)
+    , rhs(rhs)
 {
-    this->other->update_parents();
 }
 
 Statement::~Statement() {}
 
+bool Statement::eval(const EvaluationContext &ec, ExprId e)
+{
+    ProfileScope scope("eval");
+    if (!program || program->root() != e) {
+        program = std::make_unique<Program>(*store, e);
+    }
+    return program->run(ec);
+}
+
+// Prints the assignment of a witness, [a: tt, b: ff]
+static void print_assignment(const ExpressionStore &store, const std::vector<std::pair<AtomId, bool>> &assignment, FILE *out)
+{
+    fprintf(out, "[");
+    for (std::size_t i = 0; i < assignment.size(); i++) {
+        fprintf(out, "%s%s: %s", i ? ", " : "", store.name(assignment[i].first).c_str(), assignment[i].second ? "tt" : "ff");
+    }
+    fprintf(out, "]");
+}
+
+void Statement::verify(const EvaluationContext &ec, const char *transform, ExprId result)
+{
+    if (!ec.check) {
+        return;
+    }
+    ProfileScope scope("check");
+    const auto   miter = check_equivalence(*store, other, result, ec.threads, nullptr, false);
+    if (!miter.equivalent) {
+        fprintf(ec.out, "  check failed: %s differs from the input under ", transform);
+        print_assignment(*store, miter.witness, ec.out);
+        fprintf(ec.out, "\n");
+    }
+}
+
+const char *Statement::name() const
+{
+    static const char *const names[] = {
+        "print", "set", "print atoms", "print table", "print table sat", "print table unsat",
+        "print table count", "print nnf", "print knf", "print cnf", "print sat", "print dimacs",
+        "print count", "print bdd", "print equiv", "print paths", "print simplified", "print equiv ;",
+        "print taut", "print walk",
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == PrintWalk + 1, "a name for every statement type");
+    return names[type];
+}
+
 int Statement::print()
 {
     switch (type) {
     case Type::Print:
-        return printf("Print: ") + other->print();
+        return printf("Print: ") + store->print(other);
     case Type::Set:
-        return printf("Set %s to ", pred.c_str()) + other->print();
+        return printf("Set %s to ", store->name(pred).c_str()) + store->print(other);
     case Type::PrintAtoms:
-        return printf("Printing atoms of ") + other->print();
+        return printf("Printing atoms of ") + store->print(other);
     default:
         return printf("Unknown statement type");
     }
 }
 
+// Clauses of the KNF of e without duplicate literals, tautologies and subsumed clauses.
+// make_clauses drops the first two and repeated clauses, the preprocessor subsumed ones.
+// It keeps the variables, atoms gets the atom of each.
+static Cnf simplified_knf(ExpressionStore &store, ExprId e, std::vector<AtomId> *atoms = nullptr)
+{
+    Preprocessor::Options equivalent;
+    equivalent.pure      = false;
+    equivalent.eliminate = false;
+    return Preprocessor(make_clauses(store, e).cnf(atoms)).run(equivalent);
+}
+
 void Statement::exec(EvaluationContext &ec)
 {
+    ProfileScope scope(name());
+    if (scope.active()) {
+        const auto [nodes, depth] = store->shape(other);
+        scope.counter("nodes", nodes);
+        scope.counter("depth", depth);
+    }
+
     switch (type) {
     case Type::Print:
-        other->print();
-        printf(" ⇒ %s\n", other->eval(ec) ? "tt" : "ff");
+        store->print(other, ec.out);
+        fprintf(ec.out, " ⇒ %s\n", eval(ec, other) ? "tt" : "ff");
         break;
     case Type::Set:
-        ec.predicates[pred] = other->eval(ec);
+        ec.set(pred, eval(ec, other));
         break;
     case Type::PrintAtoms: {
-        const auto atoms = other->atoms();
-        printf("Atoms in ");
-        other->print();
-        printf(" : ");
+        const auto atoms = store->atoms(other);
+        fprintf(ec.out, "Atoms in ");
+        store->print(other, ec.out);
+        fprintf(ec.out, " : ");
         for (auto &&a : atoms) {
-            printf("%s, ", a.c_str());
+            fprintf(ec.out, "%s, ", store->name(a).c_str());
         }
-        printf("\n");
+        fprintf(ec.out, "\n");
         break;
     }
 
-    case Type::PrintTable: {
-        // 1. Get the atoms
-        // 2. for all the combinations print the row
-        // Assuming only up to depth 2
-        auto atoms = other->atoms();
-        atoms.sort();
-        atoms.erase(std::unique(begin(atoms), end(atoms)), end(atoms));
-
-        const auto                       rows     = 2 ^ atoms.size();
-        const std::list<bool>            elements = { false, true };
-        const std::list<std::list<bool>> cpin(atoms.size(), elements);
-
-        const auto cproduct = cartesian(cpin);
-
-        for (auto &&a : atoms) {
-            printf(" | %2s", a.c_str());
+    case Type::PrintTable:
+        print_table(*store, other, TableRows::All, ec.out);
+        break;
+    case Type::PrintTableSat:
+        print_table(*store, other, TableRows::Satisfying, ec.out);
+        break;
+    case Type::PrintTableUnsat:
+        print_table(*store, other, TableRows::Falsifying, ec.out);
+        break;
+    case Type::PrintTableCount:
+        print_table(*store, other, TableRows::Count, ec.out);
+        break;
+    case Type::PrintNNF: {
+        if (normal == NoExpr) {
+            normal = make_nnf(*store, other);
+            verify(ec, "nnf", normal);
         }
-
-        const auto     childs = other->childs();
-        std::list<int> exprlengths;
-
-        for (auto &&c : childs) {
-            printf(" | ");
-            const auto count = c->print();
-            exprlengths.push_back(count);
-
-            for (int i = 2 - count; i > 0; i--) {
-                printf(" ");
+        store->print(normal, ec.out);
+        fprintf(ec.out, " ⇒ %s\n", eval(ec, normal) ? "tt" : "ff");
+        break;
+    }
+    case Type::PrintKNF: {
+        if (ec.dimacs) {
+            const auto cnf = simplified_knf(*store, other);
+            write_dimacs(cnf, ec.out);
+            if (ec.check) {
+                verify(ec, "knf", knf_expression(*store, cnf));
             }
+            break;
         }
-
-        printf(" | ");
-        const auto count = other->print();
-        exprlengths.push_back(count);
-
-        printf(" |\n");
-
-        for (auto &&ctuple : cproduct) {
-            EvaluationContext ec;
-            std::size_t       counter = 0;
-
-            // Printing the atoms
-            for (auto &&a : ctuple) {
-                auto atom = begin(atoms);
-                advance(atom, counter++);
-                ec.predicates[*atom] = a;
-
-                printf(" | %*s", static_cast<int>(atom->length()), a ? "tt" : "ff");
+        // The tree form is only built for --check
+        if (!knf) {
+            std::vector<AtomId> atoms;
+            const auto          cnf = simplified_knf(*store, other, &atoms);
+            knf                     = std::make_unique<ClauseStore>(cnf, atoms);
+            if (ec.check) {
+                verify(ec, "knf", knf->expression(*store));
             }
-            counter = 0;
-
-            // 1. level depth
-            auto exprlength = begin(exprlengths);
-            for (auto &&c : childs) {
-                printf(" | %*s", *exprlength, c->eval(ec) ? "tt" : "ff");
-                advance(exprlength, 1);
+        }
+        knf->print(*store, ec.out);
+        fprintf(ec.out, " ⇒ %s\n", knf->eval(ec) ? "tt" : "ff");
+        break;
+    }
+    case Type::PrintCNF: {
+        store->print(other, ec.out);
+        fprintf(ec.out, " ⇒ ");
+        const auto cnf = tseitin_clauses(*store, simplify(*store, other), store->atoms(other));
+        print_cnf(cnf, ec.out);
+        fprintf(ec.out, " (%zu atoms, %zu auxiliary, %zu clauses)\n", cnf.inputs, cnf.atoms.size() - cnf.inputs, cnf.size());
+        break;
+    }
+    case Type::PrintSat: {
+        store->print(other, ec.out);
+
+        const auto start = std::chrono::steady_clock::now();
+        if (auto &solver = ec.incremental) {
+            const auto conflicts = solver->stats().conflicts;
+            const auto result    = solver->solve(other, ec);
+            const auto ms        = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            const auto &atoms    = store->atoms(other);
+
+            if (result == sat::Result::Sat) {
+                fprintf(ec.out, " ⇒ sat [");
+                for (std::size_t i = 0; i < atoms.size(); i++) {
+                    fprintf(ec.out, "%s%s: %s", i ? ", " : "", store->name(atoms[i]).c_str(), solver->value(atoms[i]) ? "tt" : "ff");
+                }
+                fprintf(ec.out, "]");
+            } else {
+                fprintf(ec.out, " ⇒ unsat, failed [");
+                const auto &failed = solver->failed();
+                for (std::size_t i = 0; i < failed.size(); i++) {
+                    fprintf(ec.out, "%s%s: %s", i ? ", " : "", store->name(failed[i].first).c_str(), failed[i].second ? "tt" : "ff");
+                }
+                fprintf(ec.out, "]");
             }
+            fprintf(ec.out, " (%zu atoms, %zu clauses, %llu conflicts, %.3f ms)\n", atoms.size(), solver->clauses(),
+                    static_cast<unsigned long long>(solver->stats().conflicts - conflicts), ms);
+            break;
+        }
 
-            // 0. level depth
-            printf(" | %*s", *exprlength, other->eval(ec) ? "tt" : "ff");
+        const auto                    cnf = tseitin_clauses(*store, simplify(*store, other), store->atoms(other));
+        std::unique_ptr<Preprocessor> pre;
+        if (ec.preprocess) {
+            pre = std::make_unique<Preprocessor>(cnf);
+        }
 
-            printf(" |\n");
+        // --check certifies unsat with a proof, see proof.h
+        const auto  simplified = pre ? pre->run({}) : Cnf{};
+        const auto &clauses    = pre ? simplified : cnf;
+        ProofCheck  certificate;
+        auto        solved = ec.check ? solve_certified(clauses, certificate) : solve_portfolio(clauses, ec.threads);
+        const auto ms     = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (pre && solved.result == sat::Result::Sat) {
+            pre->extend(solved.model);
         }
 
+        if (solved.result == sat::Result::Sat) {
+            fprintf(ec.out, " ⇒ sat [");
+            for (std::size_t v = 0; v < cnf.inputs; v++) {
+                fprintf(ec.out, "%s%s: %s", v ? ", " : "", cnf.atoms[v].c_str(), solved.model[v] ? "tt" : "ff");
+            }
+            fprintf(ec.out, "]");
+        } else {
+            fprintf(ec.out, " ⇒ unsat");
+        }
+        fprintf(ec.out, " (%zu atoms, %zu clauses, %llu conflicts, %.3f ms)\n", cnf.inputs, cnf.size(),
+                static_cast<unsigned long long>(solved.stats.conflicts), ms);
+        if (pre) {
+            fprintf(ec.out, "  preprocessed ");
+            print_stats(pre->stats(), ec.out);
+            fprintf(ec.out, "\n");
+        }
+        if (ec.check && solved.result == sat::Result::Unsat && !certificate.verified) {
+            fprintf(ec.out, "  check failed: the proof of unsat does not hold, %s\n", certificate.error.c_str());
+        }
         break;
     }
-    case Type::PrintNNF: {
-        make_nnf(other);
-        other->print();
-        printf(" ⇒ %s\n", other->eval(ec) ? "tt" : "ff");
+    case Type::PrintSimplified: {
+        store->print(other, ec.out);
+        fprintf(ec.out, " ⇒ ");
+        const auto before     = store->shape(other).first;
+        const auto simplified = simplify(*store, other);
+        store->print(simplified, ec.out);
+        fprintf(ec.out, " (%zu → %zu nodes)\n", before, store->shape(simplified).first);
+        verify(ec, "simplify", simplified);
         break;
     }
-    case Type::PrintKNF: {
-        make_knf(other);
-        other->print();
-        printf(" ⇒ %s\n", other->eval(ec) ? "tt" : "ff");
+    case Type::PrintDimacs: {
+        const auto cnf = simplified_knf(*store, other);
+        write_dimacs(cnf, ec.out);
+        if (ec.check) {
+            verify(ec, "knf", knf_expression(*store, cnf));
+        }
+        break;
+    }
+    case Type::PrintCount: {
+        store->print(other, ec.out);
+
+        const auto          start = std::chrono::steady_clock::now();
+        ModelCounter::Stats stats;
+        const auto          count = count_models(*store, other, projection.empty() ? nullptr : &projection, &stats);
+        const auto          ms    = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        fprintf(ec.out, " ⇒ %s models", count.str().c_str());
+        if (!projection.empty()) {
+            fprintf(ec.out, " over [");
+            for (std::size_t i = 0; i < projection.size(); i++) {
+                fprintf(ec.out, "%s%s", i ? ", " : "", store->name(projection[i]).c_str());
+            }
+            fprintf(ec.out, "]");
+        }
+        fprintf(ec.out, " (%zu atoms, %llu decisions, %llu cache hits, %.3f ms)\n", store->atoms(other).size(),
+                static_cast<unsigned long long>(stats.decisions), static_cast<unsigned long long>(stats.cache_hits), ms);
+        break;
+    }
+    case Type::PrintBdd: {
+        store->print(other, ec.out);
+
+        const auto start = std::chrono::steady_clock::now();
+        BddManager mgr;
+        const auto f      = make_bdd(mgr, *store, other);
+        const auto models = mgr.count(f, store->atoms(other));
+        const auto ms     = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        fprintf(ec.out, " ⇒ %s (%zu nodes, %s models, order [", f.tautology() ? "tautology" : f.unsat() ? "unsat" : "sat", mgr.size(f),
+                models.str().c_str());
+        const auto order = mgr.order();
+        for (std::size_t i = 0; i < order.size(); i++) {
+            fprintf(ec.out, "%s%s", i ? ", " : "", store->name(order[i]).c_str());
+        }
+        fprintf(ec.out, "], %llu reorderings, %.3f ms)\n", static_cast<unsigned long long>(mgr.stats().reorderings), ms);
+        break;
+    }
+    case Type::PrintEquiv: {
+        store->print(other, ec.out);
+        fprintf(ec.out, " ≡ ");
+        store->print(rhs, ec.out);
+
+        const auto start = std::chrono::steady_clock::now();
+        BddManager mgr;
+        const auto f  = make_bdd(mgr, *store, other);
+        const auto g  = make_bdd(mgr, *store, rhs);
+        const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (f == g) {
+            fprintf(ec.out, " ⇒ tt");
+        } else {
+            // Any path of f ≢ g is an assignment the two disagree on
+            BddManager::Cube witness;
+            bool             found = false;
+            mgr.paths(!mgr.equiv(f, g), [&](const BddManager::Cube &cube) {
+                if (!found) {
+                    witness = cube;
+                    found   = true;
+                }
+            });
+            fprintf(ec.out, " ⇒ ff [");
+            for (std::size_t i = 0; i < witness.size(); i++) {
+                fprintf(ec.out, "%s%s: %s", i ? ", " : "", store->name(witness[i].first).c_str(), witness[i].second ? "tt" : "ff");
+            }
+            fprintf(ec.out, "]");
+        }
+        fprintf(ec.out, " (%zu + %zu nodes, %.3f ms)\n", mgr.size(f), mgr.size(g), ms);
+        break;
+    }
+    case Type::PrintPaths: {
+        store->print(other, ec.out);
+
+        BddManager                    mgr;
+        const auto                    f = make_bdd(mgr, *store, other);
+        std::vector<BddManager::Cube> paths;
+        mgr.paths(f, [&](const BddManager::Cube &cube) { paths.push_back(cube); });
+
+        fprintf(ec.out, " ⇒ %zu paths\n", paths.size());
+        for (const auto &cube : paths) {
+            fprintf(ec.out, "  [");
+            for (std::size_t i = 0; i < cube.size(); i++) {
+                fprintf(ec.out, "%s%s: %s", i ? ", " : "", store->name(cube[i].first).c_str(), cube[i].second ? "tt" : "ff");
+            }
+            fprintf(ec.out, "]\n");
+        }
+        break;
+    }
+    case Type::PrintMiter:
+    case Type::PrintTaut: {
+        store->print(other, ec.out);
+        if (type == PrintMiter) {
+            fprintf(ec.out, " ≡ ");
+            store->print(rhs, ec.out);
+        }
+
+        // --check certifies tt with a proof, see proof.h
+        ProofCheck certificate;
+        const auto start  = std::chrono::steady_clock::now();
+        const auto result = type == PrintMiter ? check_equivalence(*store, other, rhs, ec.threads, ec.check ? &certificate : nullptr)
+                                               : check_tautology(*store, other, ec.threads, ec.check ? &certificate : nullptr);
+        const auto ms     = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (result.equivalent) {
+            fprintf(ec.out, " ⇒ tt");
+        } else {
+            fprintf(ec.out, " ⇒ ff ");
+            print_assignment(*store, result.witness, ec.out);
+        }
+        fprintf(ec.out, " (%zu clauses, %llu conflicts, %.3f ms)\n", result.clauses, static_cast<unsigned long long>(result.conflicts), ms);
+        if (ec.check && result.equivalent && !certificate.verified) {
+            fprintf(ec.out, "  check failed: the proof of tt does not hold, %s\n", certificate.error.c_str());
+        }
+        break;
+    }
+    case Type::PrintWalk: {
+        store->print(other, ec.out);
+
+        // Walks the KNF itself, auxiliary variables of a Tseitin encoding only slow a walk down
+        const auto start = std::chrono::steady_clock::now();
+        if (!knf) {
+            knf = std::make_unique<ClauseStore>(make_clauses(*store, other));
+        }
+        std::vector<AtomId> atoms;
+        const auto          cnf    = knf->cnf(&atoms);
+        const auto          result = local_search(cnf, ec.walk ? *ec.walk : WalkOptions{}, ec.threads);
+        const auto ms     = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // Atoms the clauses lost do not matter, they are left out
+        if (result.found) {
+            fprintf(ec.out, " ⇒ sat [");
+            for (std::size_t v = 0; v < cnf.atoms.size(); v++) {
+                fprintf(ec.out, "%s%s: %s", v ? ", " : "", cnf.atoms[v].c_str(), result.model[v] ? "tt" : "ff");
+            }
+            fprintf(ec.out, "]");
+        } else {
+            fprintf(ec.out, " ⇒ unknown");
+        }
+        fprintf(ec.out, " (%zu atoms, %zu clauses, %llu flips, %.3f ms)\n", cnf.atoms.size(), cnf.size(),
+                static_cast<unsigned long long>(result.flips), ms);
+
+        if (ec.check && result.found) {
+            EvaluationContext model;
+            for (std::size_t v = 0; v < cnf.atoms.size(); v++) {
+                model.set(atoms[v], result.model[v]);
+            }
+            if (!eval(model, other)) {
+                fprintf(ec.out, "  check failed: the model does not satisfy the formula\n");
+            }
+        }
         break;
     }
     default:
@@ -162,156 +597,266 @@ void Statement::exec(EvaluationContext &ec)
     }
 }
 
-void make_nnf(std::shared_ptr<Expression> &input)
+// NNF of e, or of ¬e if negated. Every node is rewritten at most once per polarity,
+// later occurrences of the same subformula reuse the cached result.
+static ExprId nnf(ExpressionStore &store, ExprId e, bool negated)
 {
-    OverloadedVisitor implremover{ [](std::shared_ptr<BinaryExpression> expr) {
-                                      if (expr->op == BinaryExpression::Impl) {
-                                          expr->op  = BinaryExpression::Or;
-                                          auto nota = std::make_shared<NegExpression>(expr->lhs, expr);
-                                          expr->lhs = std::move(nota);
-                                      } else if (expr->op == BinaryExpression::BiImpl) {
-                                          const auto a    = expr->lhs;
-                                          const auto b    = expr->rhs;
-                                          const auto nota = std::make_shared<NegExpression>(a, expr);
-
-                                          const auto a2   = a->deepcopy();
-                                          const auto b2   = b->deepcopy();
-                                          const auto notb = std::make_shared<NegExpression>(b2, expr);
-
-                                          expr->lhs = std::make_shared<BinaryExpression>(nota, b, BinaryExpression::Or, expr);
-                                          expr->rhs = std::make_shared<BinaryExpression>(notb, a2, BinaryExpression::Or, expr);
-                                          expr->op  = BinaryExpression::And;
-                                      }
-                                      return true;
-                                  },
-                                   [](auto &&) { return true; }, [](auto &&) { return false; }, [](auto &&) { return false; } };
-
-    OverloadedVisitor nnf{ [](std::shared_ptr<BinaryExpression> expr) {
-                              { // clang format you good?
-                                  auto a = expr->lhs;
-                                  auto b = expr->rhs;
-                                  make_nnf(a);
-                                  make_nnf(b);
-                                  expr->lhs = a;
-                                  expr->rhs = b;
-                                  return false;
-                              }
-                          },
-                           [&input](std::shared_ptr<NegExpression> expr) {
-                               // Double neg
-                               if (dynamic_cast<NegExpression *>(expr->childs().front().get())) {
-                                   auto e = expr->childs().front()->childs().front();
-                                   make_nnf(e);
-                                   e->parent = input->parent;
-                                   input     = e;
-                                   return false; // Maybe false?
-                               } else if (auto *bexpr = dynamic_cast<BinaryExpression *>(expr->childs().front().get())) {
-                                   if (bexpr->op == BinaryExpression::And) {
-                                       const auto b    = bexpr->lhs;
-                                       const auto c    = bexpr->rhs;
-                                       const auto notb = std::make_shared<NegExpression>(b);
-                                       const auto notc = std::make_shared<NegExpression>(c);
-
-                                       auto notbornotc    = std::make_shared<BinaryExpression>(notb, notc, BinaryExpression::Or);
-                                       notbornotc->parent = input->parent;
-
-                                       input = notbornotc;
-                                       make_nnf(input);
-                                   } else if (bexpr->op == BinaryExpression::Or) {
-                                       const auto b    = bexpr->lhs;
-                                       const auto c    = bexpr->rhs;
-                                       const auto notb = std::make_shared<NegExpression>(b);
-                                       const auto notc = std::make_shared<NegExpression>(c);
-
-                                       auto notbornotc    = std::make_shared<BinaryExpression>(notb, notc, BinaryExpression::And);
-                                       notbornotc->parent = input->parent;
-
-                                       input = notbornotc;
-                                       make_nnf(input);
-                                   }
-                               }
-
-                               return false;
-                           },
-                           [](auto &&) { return false; }, [](auto &&) { return false; } };
-
-    input->visit(implremover);
-    input->visit(nnf);
+    struct Polar {
+        ExprId e;
+        bool   negated;
+    };
+    const auto rewrite = [](bool negated) { return negated ? ExpressionStore::NegatedNNF : ExpressionStore::NNF; };
+    const auto done    = [&](ExprId e, bool negated) { return store.cached(rewrite(negated), e); };
+
+    Traversal<Polar> traversal;
+    traversal.run(
+        { e, negated },
+        [&](const Polar &item, const auto &push) {
+            if (done(item.e, item.negated) != NoExpr) {
+                return false;
+            }
+            const auto node = store[item.e];
+            switch (node.op) {
+            case Expression::Neg:
+                push({ node.lhs, !item.negated });
+                break;
+            case Expression::And:
+            case Expression::Or:
+                push({ node.lhs, item.negated });
+                push({ node.rhs, item.negated });
+                break;
+            case Expression::Impl:
+                push({ node.lhs, !item.negated });
+                push({ node.rhs, item.negated });
+                break;
+            case Expression::BiImpl:
+                push({ node.lhs, false });
+                push({ node.lhs, true });
+                push({ node.rhs, false });
+                push({ node.rhs, true });
+                break;
+            default:
+                break;
+            }
+            return true;
+        },
+        [&](const Polar &item) {
+            const auto node    = store[item.e];
+            const bool negated = item.negated;
+            ExprId     result  = item.e;
+            switch (node.op) {
+            case Expression::Neg:
+                result = done(node.lhs, !negated);
+                break;
+            case Expression::Constant:
+            case Expression::Pred:
+                result = negated ? store.neg(item.e) : item.e;
+                break;
+            case Expression::And:
+            case Expression::Or: {
+                const auto op = (node.op == Expression::And) != negated ? Expression::And : Expression::Or;
+                result        = store.binary(op, done(node.lhs, negated), done(node.rhs, negated));
+                break;
+            }
+            case Expression::Impl:
+                // a → b = ¬a ∨ b
+                result = store.binary(negated ? Expression::And : Expression::Or, done(node.lhs, !negated), done(node.rhs, negated));
+                break;
+            case Expression::BiImpl: {
+                // a ↔ b = (¬a ∨ b) ∧ (¬b ∨ a)
+                const auto a = node.lhs;
+                const auto b = node.rhs;
+                if (negated) {
+                    result = store.binary(Expression::Or, store.binary(Expression::And, done(a, false), done(b, true)),
+                                          store.binary(Expression::And, done(b, false), done(a, true)));
+                } else {
+                    result = store.binary(Expression::And, store.binary(Expression::Or, done(a, true), done(b, false)),
+                                          store.binary(Expression::Or, done(b, true), done(a, false)));
+                }
+                break;
+            }
+            };
+            store.cache(rewrite(negated), item.e, result);
+        });
+    return done(e, negated);
 }
 
-void make_knf(std::shared_ptr<Expression> &input, bool skipnnf)
+// Size and depth of a rewrite's input and output and how many nodes it added to the store,
+// where the tree representation used to deep copy
+static void record_rewrite(ProfileScope &scope, const ExpressionStore &store, ExprId input, ExprId output, std::size_t size)
 {
-    if (!skipnnf) {
-        make_nnf(input);
+    if (!scope.active()) {
+        return;
     }
+    const auto before = store.shape(input);
+    const auto after  = store.shape(output);
+    scope.counter("nodes_before", before.first);
+    scope.counter("nodes_after", after.first);
+    scope.counter("depth_before", before.second);
+    scope.counter("depth_after", after.second);
+    scope.counter("created", store.size() - size);
+}
 
-    bool              isdisjunkofliterals = true;
-    OverloadedVisitor disofliterals{ [&isdisjunkofliterals](auto &&expr) {
-                                        if (expr->op != BinaryExpression::Or) {
-                                            isdisjunkofliterals = false;
-                                            return false;
-                                        }
-                                        return true;
-                                    },
-                                     [](auto &&expr) { return true; }, [](auto &&expr) { return false; },
-                                     [](auto &&expr) { return false; } };
+// Copy of e with its constants folded and double negations removed, otherwise as written
+static ExprId fold_constants(ExpressionStore &store, ExprId e)
+{
+    std::vector<ExprId> folded(store.size(), NoExpr);
+    const auto          value  = [&](ExprId e) { return store[e].op == Expression::Constant ? int(store[e].lhs) : -1; };
+    const auto          negate = [&](ExprId e) {
+        const auto &node = store[e];
+        if (node.op == Expression::Constant) {
+            return store.constant(!node.lhs);
+        }
+        return node.op == Expression::Neg ? ExprId(node.lhs) : store.neg(e);
+    };
 
-    input->visit(disofliterals);
+    Traversal<ExprId> traversal;
+    traversal.run(
+        e,
+        [&](ExprId e, const auto &push) {
+            if (folded[e] != NoExpr) {
+                return false;
+            }
+            const auto &node = store[e];
+            if (node.binary() || node.op == Expression::Neg) {
+                push(node.lhs);
+            }
+            if (node.binary()) {
+                push(node.rhs);
+            }
+            return true;
+        },
+        [&](ExprId e) {
+            const auto node = store[e];
+            const auto l    = node.binary() || node.op == Expression::Neg ? folded[node.lhs] : NoExpr;
+            const auto r    = node.binary() ? folded[node.rhs] : NoExpr;
+            const auto a    = l == NoExpr ? -1 : value(l);
+            const auto b    = r == NoExpr ? -1 : value(r);
+            switch (node.op) {
+            case Expression::And:
+                folded[e] = a == 0 || b == 0 ? store.constant(false) : a == 1 ? r : b == 1 ? l : store.binary(node.op, l, r);
+                break;
+            case Expression::Or:
+                folded[e] = a == 1 || b == 1 ? store.constant(true) : a == 0 ? r : b == 0 ? l : store.binary(node.op, l, r);
+                break;
+            case Expression::Impl:
+                folded[e] = a == 0 || b == 1 ? store.constant(true) : a == 1 ? r : b == 0 ? negate(l) : store.binary(node.op, l, r);
+                break;
+            case Expression::BiImpl:
+                folded[e] = a == 1 ? r : b == 1 ? l : a == 0 ? negate(r) : b == 0 ? negate(l) : store.binary(node.op, l, r);
+                break;
+            case Expression::Neg:
+                folded[e] = negate(l);
+                break;
+            default:
+                folded[e] = e;
+                break;
+            }
+        });
+    return folded[e];
+}
 
-    if (isdisjunkofliterals) {
-        return;
+ExprId simplify(ExpressionStore &store, ExprId input)
+{
+    if (const auto done = store.cached(ExpressionStore::Simplified, input); done != NoExpr) {
+        return done;
+    }
+    ProfileScope scope("simplify");
+    const auto   size = store.size();
+    Aig          aig;
+    auto         output = aig.raise(store, aig.lower(store, input));
+    scope.counter("gates", aig.gates());
+    // Raising picks connectives locally and can come out a few nodes larger than a
+    // formula there was little to simplify in, folding its constants is enough then
+    const auto folded = fold_constants(store, input);
+    if (store.shape(output).first > store.shape(folded).first) {
+        output = folded;
     }
+    record_rewrite(scope, store, input, output, size);
+    return store.cache(ExpressionStore::Simplified, input, output);
+}
 
-    OverloadedVisitor knftransform{
-        [&input](std::shared_ptr<BinaryExpression> expr) {
-            if (expr->op == BinaryExpression::And) {
-                auto a = expr->lhs;
-                auto b = expr->rhs;
-                make_knf(a, true);
-                make_knf(b, true);
-                a->parent = expr;
-                b->parent = expr;
-                expr->lhs = a;
-                expr->rhs = b;
-            } else if (expr->op == BinaryExpression::Or) {
-                // KNF(A or B)
-                auto a = expr->lhs;
-                auto b = expr->rhs;
-
-                if (auto abinary = dynamic_cast<BinaryExpression *>(a.get()); abinary && abinary->op == BinaryExpression::And) {
-                    // KNF((a1 and a2) or B)
-                    auto a1 = abinary->lhs;
-                    auto a2 = abinary->rhs;
-                    auto b2 = b->deepcopy();
-
-                    // a1 or b
-                    auto a1orb = std::static_pointer_cast<Expression>(std::make_shared<BinaryExpression>(a1, b, BinaryExpression::Or));
-                    make_knf(a1orb, true);
-
-                    // a2 or b
-                    auto a2orb = std::static_pointer_cast<Expression>(std::make_shared<BinaryExpression>(a2, b2, BinaryExpression::Or));
-                    make_knf(a2orb, true);
-
-                    input = std::make_shared<BinaryExpression>(a1orb, a2orb, BinaryExpression::And, input->parent);
-                } else if (auto bbinary = dynamic_cast<BinaryExpression *>(b.get()); bbinary && bbinary->op == BinaryExpression::And) {
-                    // KNF(A or (b1 and b2)
-                    auto b1 = bbinary->lhs;
-                    auto b2 = bbinary->rhs;
-                    auto a2 = a->deepcopy();
-
-                    auto b1ora = std::static_pointer_cast<Expression>(std::make_shared<BinaryExpression>(b1, a, BinaryExpression::Or));
-                    make_knf(b1ora);
-
-                    auto b2ora = std::static_pointer_cast<Expression>(std::make_shared<BinaryExpression>(b2, a, BinaryExpression::Or));
-                    make_knf(b2ora, true);
-
-                    input = std::make_shared<BinaryExpression>(b1ora, b2ora, BinaryExpression::And, input->parent);
-                }
+ExprId make_nnf(ExpressionStore &store, ExprId input)
+{
+    ProfileScope scope("make_nnf");
+    const auto   size   = store.size();
+    const auto   output = nnf(store, simplify(store, input), false);
+    record_rewrite(scope, store, input, output, size);
+    return output;
+}
+
+// KNF(A ∨ B) for A and B already in KNF, pairs and results are scratch space of the caller
+static ExprId distribute(ExpressionStore &store, ExprId a, ExprId b, Traversal<std::pair<ExprId, ExprId>> &pairs,
+                         std::vector<ExprId> &results)
+{
+    pairs.run(
+        { a, b },
+        [&](const std::pair<ExprId, ExprId> &pair, const auto &push) {
+            const auto [a, b] = pair;
+            const auto anode  = store[a];
+            const auto bnode  = store[b];
+            if (anode.op == Expression::And) {
+                // (a1 ∨ B) ∧ (a2 ∨ B)
+                push({ anode.lhs, b });
+                push({ anode.rhs, b });
+                return true;
+            } else if (bnode.op == Expression::And) {
+                // (b1 ∨ A) ∧ (b2 ∨ A)
+                push({ bnode.lhs, a });
+                push({ bnode.rhs, a });
+                return true;
             }
+            results.push_back(store.binary(Expression::Or, a, b));
             return false;
         },
-        [](auto &&expr) { return false; }, [](auto &&expr) { return false; }, [](auto &&expr) { return false; }
-    };
+        [&](const std::pair<ExprId, ExprId> &) {
+            const auto rhs = results.back();
+            results.pop_back();
+            results.back() = store.binary(Expression::And, results.back(), rhs);
+        });
+    const auto result = results.back();
+    results.pop_back();
+    return result;
+}
+
+static ExprId knf(ExpressionStore &store, ExprId e)
+{
+    const auto done = [&](ExprId e) { return store.cached(ExpressionStore::KNF, e); };
+
+    Traversal<ExprId>                    traversal;
+    Traversal<std::pair<ExprId, ExprId>> pairs;
+    std::vector<ExprId>                  results;
+    traversal.run(
+        e,
+        [&](ExprId e, const auto &push) {
+            if (done(e) != NoExpr) {
+                return false;
+            }
+            const auto node = store[e];
+            if (node.op == Expression::And || node.op == Expression::Or) {
+                push(node.lhs);
+                push(node.rhs);
+            }
+            return true;
+        },
+        [&](ExprId e) {
+            const auto node   = store[e];
+            ExprId     result = e;
+            if (node.op == Expression::And) {
+                result = store.binary(Expression::And, done(node.lhs), done(node.rhs));
+            } else if (node.op == Expression::Or) {
+                result = distribute(store, done(node.lhs), done(node.rhs), pairs, results);
+            }
+            store.cache(ExpressionStore::KNF, e, result);
+        });
+    return done(e);
+}
 
-    input->visit(knftransform);
+ExprId make_knf(ExpressionStore &store, ExprId input, bool skipnnf)
+{
+    ProfileScope scope("make_knf");
+    const auto   size   = store.size();
+    const auto   output = knf(store, skipnnf ? input : make_nnf(store, input));
+    record_rewrite(scope, store, input, output, size);
+    return output;
 }
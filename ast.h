@@ -1,266 +1,185 @@
 #pragma once
+#include "symbols.h"
+#include "traversal.h"
+
+#include <cstdint>
 #include <cstdio>
-#include <list>
-#include <map>
 #include <memory>
 #include <string>
-#include <variant>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
-template<class... Ts>
-struct overloaded : Ts... {
-    using Ts::operator()...;
-};
-template<class... Ts>
-overloaded(Ts...)->overloaded<Ts...>;
+class IncrementalSolver;
+class ClauseStore;
+struct WalkOptions;
 
 struct EvaluationContext {
-    std::map<std::string, bool> predicates;
-};
-
-class Expression;
-class Statement {
-public:
-    enum Type { Print, Set, Expr, PrintAtoms, PrintTable, PrintNNF, PrintKNF };
-
-    Statement();
-    Statement(std::shared_ptr<Expression> other, Type type = Type::Print);
-    Statement(const std::string &pred, std::shared_ptr<Expression> other);
-
-    virtual ~Statement();
-
-    virtual int  print();
-    virtual void exec(EvaluationContext &ec);
-
-protected:
-    Type                        type;
-    std::string                 pred;
-    std::shared_ptr<Expression> other;
+    static constexpr std::uint8_t Unset = 2;
+
+    std::vector<std::uint8_t>          predicates; // indexed by atom, Unset for atoms never set, which read as ff
+    bool                               dimacs  = false; // print knf writes DIMACS instead of the formula
+    unsigned                           threads = 1; // solvers in the portfolio of print sat
+    std::shared_ptr<IncrementalSolver> incremental; // print sat solves under the set atoms, see incremental.h
+    bool                               preprocess = false; // print sat simplifies its clauses first, see preprocess.h
+    FILE *                             out        = stdout; // where statements print to
+    bool                               check      = false; // transforms verify their result, see miter.h
+    std::shared_ptr<const WalkOptions> walk; // print walk runs threads walkers with these, the defaults if null, see localsearch.h
+
+    bool get(AtomId atom) const { return atom < predicates.size() && predicates[atom] == 1; }
+    bool assigned(AtomId atom) const { return atom < predicates.size() && predicates[atom] != Unset; }
+    void set(AtomId atom, bool value)
+    {
+        if (atom >= predicates.size()) {
+            predicates.resize(atom + 1, Unset);
+        }
+        predicates[atom] = value;
+    }
 };
 
-class Expression : public Statement, public std::enable_shared_from_this<Expression> {
-public:
-    Expression(std::weak_ptr<Expression> parent)
-        : parent(std::move(parent))
-    {
-    }
-    virtual ~Expression() = default;
-    void        exec(EvaluationContext &ec) {}
-    virtual int eval(EvaluationContext &ec) = 0;
-    virtual int print() { return 0; };
+using ExprId = std::uint32_t;
 
-    virtual std::list<std::string>                 atoms() const { return {}; };
-    virtual std::list<std::shared_ptr<Expression>> childs() const { return {}; };
+constexpr ExprId NoExpr = UINT32_MAX;
 
-    void update_parents()
-    {
-        for (auto &&c : childs()) {
-            c->parent = shared_from_this(); // Luke, I am your father ;-;
-            c->update_parents();
-        }
-    }
+// A node of the expression DAG. Nodes live in an ExpressionStore and refer to their
+// children by index. Children are always created before their parents, so ids are a
+// topological order of every expression in the store.
+struct Expression {
+    enum Type : std::uint8_t { And, Or, Impl, BiImpl, Neg, Constant, Pred };
 
-    virtual std::shared_ptr<Expression> deepcopy() const = 0;
+    Type          op;
+    std::uint32_t lhs; // operand of Neg, value of Constant, atom of Pred
+    std::uint32_t rhs;
 
-    virtual void visit(class Visitor &v) = 0;
+    bool binary() const { return op <= BiImpl; }
 
-    std::weak_ptr<Expression> parent;
+    bool operator==(const Expression &other) const { return op == other.op && lhs == other.lhs && rhs == other.rhs; }
 };
 
-class Visitor {
+// Owns all expressions of a script in one contiguous arena. Nodes are trivially
+// destructible, so dropping the store releases everything at once.
+//
+// Nodes are hash consed: creating a node that already exists returns the existing id,
+// so equal subformulas are stored once and two expressions are equal iff their ids are.
+class ExpressionStore {
 public:
-    virtual bool operator()(std::shared_ptr<class BinaryExpression> exp) { return true; }
-    virtual bool operator()(std::shared_ptr<class NegExpression> exp) { return true; }
-    virtual bool operator()(std::shared_ptr<class ConstantExpression> exp) { return true; }
-    virtual bool operator()(std::shared_ptr<class PredExpression> exp) { return true; }
-};
-
-template<typename BE, typename NE, typename CE, typename PE>
-struct OverloadedVisitor : Visitor {
-    template<typename BEs, typename NEs, typename CEs, typename PEs>
-    OverloadedVisitor(BEs &&bes, NEs &&nes, CEs &&ces, PEs &&pes)
-        : be(std::forward<BEs>(bes))
-        , ne(std::forward<NEs>(nes))
-        , ce(std::forward<CEs>(ces))
-        , pe(std::forward<PEs>(pes))
-    {
-    }
-
-    bool operator()(std::shared_ptr<class BinaryExpression> exp) override { return be(std::move(exp)); }
-    bool operator()(std::shared_ptr<class NegExpression> exp) override { return ne(std::move(exp)); }
-    bool operator()(std::shared_ptr<class ConstantExpression> exp) override { return ce(std::move(exp)); }
-    bool operator()(std::shared_ptr<class PredExpression> exp) override { return pe(std::move(exp)); }
+    // Results of the rewrites that are memoized per node
+    enum Rewrite { NNF, NegatedNNF, KNF, Simplified, Rewrites };
 
-private:
-    BE be;
-    NE ne;
-    CE ce;
-    PE pe;
-};
+    ExprId binary(Expression::Type op, ExprId lhs, ExprId rhs) { return add({ op, lhs, rhs }); }
+    ExprId neg(ExprId other) { return add({ Expression::Neg, other, 0 }); }
+    ExprId constant(bool value) { return add({ Expression::Constant, value, 0 }); }
+    ExprId pred(AtomId atom) { return add({ Expression::Pred, atom, 0 }); }
+    ExprId pred(const std::string &name) { return pred(SymbolTable::global().intern(name)); }
 
-template<class... Ts>
-OverloadedVisitor(Ts...)->OverloadedVisitor<Ts...>;
+    const std::string &name(AtomId atom) const { return SymbolTable::global().name(atom); }
 
-template<typename CRTP>
-class CRTPExpression : public Expression {
-public:
-    template<typename... Args>
-    CRTPExpression(Args &&... args)
-        : Expression(std::forward<Args>(args)...)
-    {
-    }
+    const Expression &operator[](ExprId e) const { return nodes[e]; }
+    std::size_t       size() const { return nodes.size(); }
 
-    void visit(Visitor &v)
+    // NoExpr if the rewrite of e was not computed yet
+    ExprId cached(Rewrite r, ExprId e) const { return e < rewrites[r].size() ? rewrites[r][e] : NoExpr; }
+    ExprId cache(Rewrite r, ExprId e, ExprId result)
     {
-        const auto recurse = v(std::static_pointer_cast<CRTP>(shared_from_this()));
-        if (recurse) {
-            for (auto &&c : childs()) {
-                c->visit(v);
-            }
+        if (rewrites[r].size() <= e) {
+            rewrites[r].resize(nodes.size(), NoExpr);
         }
+        return rewrites[r][e] = result;
     }
-};
 
-class BinaryExpression : public CRTPExpression<BinaryExpression> {
-public:
-    enum Type { And, Or, Impl, BiImpl };
-
-    BinaryExpression(std::shared_ptr<Expression> lhs, std::shared_ptr<Expression> rhs, Type op, std::weak_ptr<Expression> parent = {})
-        : CRTPExpression(std::move(parent))
-        , lhs(std::move(lhs))
-        , rhs(std::move(rhs))
-        , op(op)
-    {
-    }
+    int                 print(ExprId e, FILE *out = stdout) const; // returns the width in columns
+    std::vector<ExprId> childs(ExprId e) const;
 
-    int eval(EvaluationContext &ec) override
-    {
-        switch (op) {
-        case Type::And:
-            return lhs->eval(ec) && rhs->eval(ec);
-        case Type::Or:
-            return lhs->eval(ec) || rhs->eval(ec);
-        case Type::Impl:
-            return !lhs->eval(ec) || rhs->eval(ec);
-        case Type::BiImpl:
-            return lhs->eval(ec) == rhs->eval(ec);
-        };
-    }
+    // Distinct atoms of e sorted by id, cached per node. Not safe for concurrent use.
+    const std::vector<AtomId> &atoms(ExprId e) const;
 
-    int print() override
-    {
-        printf("(");
-        const int lc = lhs->print();
-        switch (op) {
-        case Type::And:
-            printf(" ∧ ");
-            break;
-        case Type::Or:
-            printf(" ∨ ");
-            break;
-        case Type::Impl:
-            printf(" → ");
-            break;
-        case Type::BiImpl:
-            printf(" ↔ ");
-            break;
-        };
-        const int rc = rhs->print();
-        printf(")");
-        return 2 + 3 + lc + rc;
-    }
+    // Distinct nodes of e and the number of nodes on its longest path to a leaf
+    std::pair<std::size_t, std::size_t> shape(ExprId e) const;
 
-    virtual std::list<std::string> atoms() const override
+    // Calls f(id, node) in preorder, the children of a node are only visited if f returns true
+    template<typename F>
+    void visit(ExprId e, F &&f) const
     {
-        auto       ats    = lhs->atoms();
-        const auto rhsats = rhs->atoms();
-        ats.insert(end(ats), begin(rhsats), end(rhsats));
-        return ats;
+        Traversal<ExprId> traversal;
+        traversal.run(
+            e,
+            [&](ExprId id, const auto &push) {
+                const auto node = nodes[id];
+                if (f(id, node)) {
+                    if (node.binary()) {
+                        push(node.lhs);
+                        push(node.rhs);
+                    } else if (node.op == Expression::Neg) {
+                        push(node.lhs);
+                    }
+                }
+                return false;
+            },
+            [](ExprId) {});
     }
 
-    virtual std::list<std::shared_ptr<Expression>> childs() const override { return { lhs, rhs }; }
+private:
+    ExprId add(Expression node);
+    void   grow();
 
-    virtual std::shared_ptr<Expression> deepcopy() const override
-    {
-        return std::make_shared<BinaryExpression>(lhs->deepcopy(), rhs->deepcopy(), op);
-    }
+    std::vector<Expression> nodes;
+    std::vector<ExprId>     table; // open addressing unique table, NoExpr marks free slots
+    std::vector<ExprId>     rewrites[Rewrites];
 
-    Type                        op;
-    std::shared_ptr<Expression> lhs, rhs;
+    mutable std::unordered_map<ExprId, std::vector<AtomId>> atomsets;
 };
 
-class PredExpression : public CRTPExpression<PredExpression> {
+class Statement {
 public:
-    PredExpression(const std::string &name, std::weak_ptr<Expression> parent = {})
-        : CRTPExpression(std::move(parent))
-        , name(name)
-    {
-    }
-    int print() override
-    {
-        printf("%s", name.c_str());
-        return name.length();
-    }
-    int eval(EvaluationContext &ec) override { return ec.predicates[name]; }
-
-    std::list<std::string> atoms() const override { return { name }; }
+    enum Type { Print, Set, PrintAtoms, PrintTable, PrintTableSat, PrintTableUnsat, PrintTableCount, PrintNNF, PrintKNF, PrintCNF, PrintSat, PrintDimacs, PrintCount, PrintBdd, PrintEquiv, PrintPaths, PrintSimplified, PrintMiter, PrintTaut, PrintWalk };
 
-    virtual std::shared_ptr<Expression> deepcopy() const override { return std::make_shared<PredExpression>(name); }
+    Statement(ExpressionStore &store, ExprId other, Type type = Type::Print);
+    Statement(ExpressionStore &store, AtomId pred, ExprId other);
+    Statement(ExpressionStore &store, ExprId other, std::vector<AtomId> projection); // print count
+    Statement(ExpressionStore &store, ExprId other, ExprId rhs, Type type); // print equiv, both forms
 
-private:
-    std::string name;
-};
-
-class ConstantExpression : public CRTPExpression<ConstantExpression> {
-public:
-    ConstantExpression(bool value, std::weak_ptr<Expression> parent = {})
-        : CRTPExpression(std::move(parent))
-        , value(value)
-    {
-    }
+    virtual ~Statement();
 
-    int print() override
-    {
-        printf("%s", value ? "tt" : "ff");
-        return 2;
-    }
-    int eval(EvaluationContext &) override { return value; }
+    virtual int  print();
+    virtual void exec(EvaluationContext &ec); // can run again, keeps normal forms and programs for that
 
-    std::list<std::string> atoms() const override { return {}; }
+    const char *name() const; // statement as written, "print knf" for PrintKNF
 
-    virtual std::shared_ptr<Expression> deepcopy() const override { return std::make_shared<ConstantExpression>(value); }
+    ExprId expression() const { return other; }
 
-private:
-    bool value;
+protected:
+    // Evaluates e, other or its normal form, through a compiled program which is kept for
+    // later evaluations
+    bool eval(const EvaluationContext &ec, ExprId e);
+
+    // With ec.check, reports when the result of transform is not equivalent to other
+    void verify(const EvaluationContext &ec, const char *transform, ExprId result);
+
+    ExpressionStore *              store;
+    Type                           type;
+    AtomId                         pred = 0;
+    std::vector<AtomId>            projection; // atoms print count counts over, all if empty
+    ExprId                         other;
+    ExprId                         rhs    = NoExpr; // second operand of both forms of print equiv
+    ExprId                         normal = NoExpr; // NNF of other once print nnf ran
+    std::unique_ptr<class Program> program;
+    std::unique_ptr<ClauseStore>   knf; // of other once print knf or print walk ran, printed and evaluated from the clauses
 };
 
-class NegExpression : public CRTPExpression<NegExpression> {
+// Receives the statements of a script from the parser one at a time, in order
+class StatementSink {
 public:
-    NegExpression(std::shared_ptr<Expression> other, std::weak_ptr<Expression> parent = {})
-        : CRTPExpression(std::move(parent))
-        , other(std::move(other))
-    {
-    }
-
-    int print() override
-    {
-        printf("(¬");
-        const int c = other->print();
-        printf(")");
-
-        return 3 + c;
-    }
-
-    int eval(EvaluationContext &ec) override { return !other->eval(ec); }
+    virtual ~StatementSink() = default;
 
-    std::list<std::string>                 atoms() const override { return { other->atoms() }; }
-    std::list<std::shared_ptr<Expression>> childs() const override { return { other }; }
-    virtual std::shared_ptr<Expression>    deepcopy() const override { return std::make_shared<NegExpression>(other->deepcopy()); }
+    virtual void push(Statement *stmt) = 0; // takes ownership
 
-    std::shared_ptr<Expression> other;
+    // True while the scanner waits for the next token. The parser only touches the
+    // expression store outside of that.
+    virtual void scanning(bool) {}
 };
 
-class StatementList {
+// Collects the whole script and runs it once parsing is done
+class StatementList : public StatementSink {
 public:
     StatementList() = default;
 
@@ -280,6 +199,7 @@ public:
     StatementList &operator=(StatementList &&) = default;
 
     void add(Statement *stmt) { statements.push_back(stmt); }
+    void push(Statement *stmt) override { add(stmt); }
 
     virtual ~StatementList()
     {
@@ -289,52 +209,21 @@ public:
         }
     }
 
-    void run()
+    void run(EvaluationContext ec = {})
     {
-        EvaluationContext ec;
         for (auto stmt : statements) {
             if (stmt) {
                 stmt->exec(ec);
             }
         }
-        printf("\n");
+        fprintf(ec.out, "\n");
     }
 
     std::vector<Statement *> statements;
 };
 
-class SimplePrintWalker : public Visitor {
-    bool operator()(std::shared_ptr<BinaryExpression>) override
-    {
-        printf("Found binary expression!\n");
-        return true;
-    }
-    bool operator()(std::shared_ptr<NegExpression>) override
-    {
-        printf("Found neg expression!\n");
-        return true;
-    }
-    bool operator()(std::shared_ptr<ConstantExpression>) override
-    {
-        printf("Found constant expression!\n");
-        return true;
-    }
-    bool operator()(std::shared_ptr<PredExpression>) override
-    {
-        printf("Found pred expression!\n");
-        return true;
-    }
-};
-
-namespace nnf {
-class Walker : public Visitor {
-public:
-    bool operator()(std::shared_ptr<BinaryExpression> e) override { return false; }
-    bool operator()(std::shared_ptr<NegExpression> e) override { return false; }
-    bool operator()(std::shared_ptr<PredExpression> e) override { return false; }
-    bool operator()(std::shared_ptr<ConstantExpression> e) override { return false; }
-};
-}
-
-void make_nnf(std::shared_ptr<Expression> &input);
-void make_knf(std::shared_ptr<Expression> &input, bool skipnnf = false);
+// Equivalent expression with constants folded and local redundancy removed, see aig.h.
+// make_nnf and the clause forms start from it, atoms it drops no longer occur in them.
+ExprId simplify(ExpressionStore &store, ExprId input);
+ExprId make_nnf(ExpressionStore &store, ExprId input);
+ExprId make_knf(ExpressionStore &store, ExprId input, bool skipnnf = false);
@@ -0,0 +1,123 @@
+#include "batch.h"
+#include "incremental.h"
+#include "parser.hpp"
+#include "profile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+Batch::Batch(std::vector<std::string> paths, EvaluationContext ec, bool incremental)
+    : jobs(paths.size())
+    , ec(std::move(ec))
+    , incremental(incremental)
+{
+    for (std::size_t i = 0; i < paths.size(); i++) {
+        jobs[i].path = std::move(paths[i]);
+    }
+}
+
+std::size_t Batch::run(unsigned workers)
+{
+    workers = static_cast<unsigned>(std::min<std::size_t>(std::max(workers, 1u), std::max<std::size_t>(jobs.size(), 1)));
+
+    // Dealt round robin the jobs a worker owns come in script order, so the output of the
+    // first ones is ready early and buffers do not pile up
+    queues.resize(workers);
+    for (std::size_t i = 0; i < jobs.size(); i++) {
+        queues[i % workers].jobs.push_back(i);
+    }
+
+    std::vector<std::thread> threads;
+    for (std::size_t w = 0; w < workers; w++) {
+        threads.emplace_back([this, w] { work(w); });
+    }
+
+    std::size_t failed = 0;
+    for (auto &job : jobs) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&job] { return job.done; });
+        }
+        printf("==> %s <==\n", job.path.c_str());
+        fwrite(job.out, 1, job.out_size, stdout);
+        fwrite(job.errors, 1, job.error_size, stderr);
+        free(job.out);
+        free(job.errors);
+        job.out    = nullptr;
+        job.errors = nullptr;
+        failed += job.failed;
+    }
+    fflush(stdout);
+
+    for (auto &t : threads) {
+        t.join();
+    }
+    return failed;
+}
+
+// Own jobs from the front, stolen ones from the back where the owner gets to them last
+bool Batch::next(std::size_t worker, std::size_t &job)
+{
+    for (std::size_t i = 0; i < queues.size(); i++) {
+        auto &                      queue = queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+        } else {
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+void Batch::work(std::size_t worker)
+{
+    std::size_t job;
+    while (next(worker, job)) {
+        execute(jobs[job]);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs[job].done = true;
+        }
+        finished.notify_all();
+    }
+}
+
+void Batch::execute(Job &job)
+{
+    ProfileScope scope("job");
+
+    FILE *out    = open_memstream(&job.out, &job.out_size);
+    FILE *errors = open_memstream(&job.errors, &job.error_size);
+    if (FILE *in = fopen(job.path.c_str(), "r")) {
+        SymbolTable        symbols;
+        SymbolTable::Scope symbols_scope(symbols);
+        ExpressionStore    store;
+        StatementList      statements;
+        EvaluationContext  local = ec;
+        local.out                = out;
+        if (incremental) {
+            local.incremental = std::make_shared<IncrementalSolver>(store);
+        }
+        job.failed = !parse_script(in, store, statements, errors);
+        fclose(in);
+        scope.counter("statements", statements.statements.size());
+        if (!job.failed) {
+            statements.run(local);
+        }
+    } else {
+        fprintf(errors, "%s: %s\n", job.path.c_str(), strerror(errno));
+        job.failed = true;
+    }
+    fclose(out);
+    fclose(errors);
+}
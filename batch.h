@@ -0,0 +1,56 @@
+#pragma once
+#include "ast.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Runs many scripts in one process, each as an independent job with its own symbol table,
+// expression store, assignments and incremental solver. Jobs are dealt round robin to per-worker
+// queues, a worker takes the oldest job of its own queue and steals the newest of another
+// one once its queue is empty.
+//
+// Every job prints into its own buffer, the calling thread writes the buffers to stdout and
+// stderr in the order the scripts were given as soon as each job is done, headed by the
+// path like head does with several files. The output of a job is the same as that of the
+// script run on its own.
+class Batch {
+public:
+    Batch(std::vector<std::string> paths, EvaluationContext ec, bool incremental);
+
+    Batch(const Batch &) = delete;
+    Batch &operator=(const Batch &) = delete;
+
+    // Returns the number of scripts that could not be read or parsed
+    std::size_t run(unsigned workers);
+
+private:
+    struct Job {
+        std::string path;
+        char *      out        = nullptr;
+        std::size_t out_size   = 0;
+        char *      errors     = nullptr;
+        std::size_t error_size = 0;
+        bool        failed     = false;
+        bool        done       = false;
+    };
+
+    struct Queue {
+        std::mutex              mutex;
+        std::deque<std::size_t> jobs;
+    };
+
+    bool next(std::size_t worker, std::size_t &job);
+    void work(std::size_t worker);
+    void execute(Job &job);
+
+    std::vector<Job>        jobs;
+    std::deque<Queue>       queues; // one per worker
+    EvaluationContext       ec;
+    bool                    incremental;
+    std::mutex              mutex; // done of every job
+    std::condition_variable finished;
+};
@@ -0,0 +1,564 @@
+#include "bdd.h"
+#include "profile.h"
+
+#include <algorithm>
+#include <numeric>
+
+Bdd::Bdd(BddManager *mgr, std::uint32_t ref)
+    : mgr(mgr)
+    , ref(ref)
+{
+    if (mgr) {
+        mgr->ref(ref);
+    }
+}
+
+Bdd::Bdd(const Bdd &other)
+    : mgr(other.mgr)
+    , ref(other.ref)
+{
+    if (mgr) {
+        mgr->ref(ref);
+    }
+}
+
+Bdd::Bdd(Bdd &&other) noexcept
+    : mgr(other.mgr)
+    , ref(other.ref)
+{
+    other.mgr = nullptr;
+}
+
+Bdd &Bdd::operator=(Bdd other) noexcept
+{
+    std::swap(mgr, other.mgr);
+    std::swap(ref, other.ref);
+    return *this;
+}
+
+Bdd::~Bdd()
+{
+    if (mgr) {
+        mgr->deref(ref);
+    }
+}
+
+Bdd Bdd::operator!() const
+{
+    return { mgr, ref ^ 1 };
+}
+
+static std::size_t hash(std::uint32_t lo, std::uint32_t hi)
+{
+    return ((static_cast<std::uint64_t>(lo) << 32 | hi) * 0x9E3779B97F4A7C15ull) >> 32;
+}
+
+static std::size_t hash(std::uint32_t f, std::uint32_t g, std::uint32_t h)
+{
+    return ((static_cast<std::uint64_t>(f) << 32 | g) * 0x9E3779B97F4A7C15ull ^ h * 0xC2B2AE3D27D4EB4Full) >> 24;
+}
+
+BddManager::BddManager()
+    : nodes{ { Terminal, 0, 0, 0, 0 } }
+    , cache(1 << 16)
+{
+}
+
+Bdd BddManager::var(AtomId atom)
+{
+    auto [it, inserted] = vars.try_emplace(atom, static_cast<std::uint32_t>(atoms.size()));
+    if (inserted) {
+        atoms.push_back(atom);
+        level_of.push_back(static_cast<std::uint32_t>(var_at.size()));
+        var_at.push_back(it->second);
+        unique.emplace_back().buckets.resize(16);
+    }
+    return { this, make(it->second, 1, 0) };
+}
+
+Bdd BddManager::ite(const Bdd &f, const Bdd &g, const Bdd &h)
+{
+    prepare();
+    return { this, ite(f.ref, g.ref, h.ref) };
+}
+
+BddManager::Ref BddManager::ite(Ref f, Ref g, Ref h)
+{
+    if (f == 0) {
+        return g;
+    }
+    if (f == 1) {
+        return h;
+    }
+    if (g == f) {
+        g = 0;
+    } else if (g == (f ^ 1)) {
+        g = 1;
+    }
+    if (h == f) {
+        h = 1;
+    } else if (h == (f ^ 1)) {
+        h = 0;
+    }
+    if (g == h) {
+        return g;
+    }
+    if (g == 0 && h == 1) {
+        return f;
+    }
+    if (g == 1 && h == 0) {
+        return f ^ 1;
+    }
+
+    // Regular f and g, ite(¬f, g, h) = ite(f, h, g) and ite(f, ¬g, ¬h) = ¬ite(f, g, h)
+    if (f & 1) {
+        f ^= 1;
+        std::swap(g, h);
+    }
+    const Ref neg = g & 1;
+    g ^= neg;
+    h ^= neg;
+
+    st.lookups++;
+    const auto slot = hash(f, g, h) & (cache.size() - 1);
+    if (const auto &entry = cache[slot]; entry.f == f && entry.g == g && entry.h == h) {
+        st.hits++;
+        return entry.r ^ neg;
+    }
+
+    const auto var = var_at[std::min({ level(f), level(g), level(h) })];
+    Ref        f0, f1, g0, g1, h0, h1;
+    cofactors(f, var, f0, f1);
+    cofactors(g, var, g0, g1);
+    cofactors(h, var, h0, h1);
+
+    const auto t = ite(f1, g1, h1);
+    const auto e = ite(f0, g0, h0);
+    const auto r = make(var, e, t);
+    cache[slot]  = { f, g, h, r };
+    return r ^ neg;
+}
+
+BddManager::Ref BddManager::make(std::uint32_t var, Ref lo, Ref hi)
+{
+    if (lo == hi) {
+        return lo;
+    }
+    if (hi & 1) {
+        return make(var, lo ^ 1, hi ^ 1) ^ 1;
+    }
+
+    const auto &table = unique[var];
+    for (auto n = table.buckets[hash(lo, hi) & (table.buckets.size() - 1)]; n; n = nodes[n].next) {
+        if (nodes[n].lo == lo && nodes[n].hi == hi) {
+            return n << 1;
+        }
+    }
+
+    std::uint32_t n;
+    if (freelist.empty()) {
+        n = static_cast<std::uint32_t>(nodes.size());
+        nodes.emplace_back();
+    } else {
+        n = freelist.back();
+        freelist.pop_back();
+    }
+    nodes[n] = { var, lo, hi, 0, 0 };
+    insert(n);
+    ref(lo);
+    ref(hi);
+    live++;
+    dead++;
+    st.peak = std::max(st.peak, live);
+    return n << 1;
+}
+
+void BddManager::insert(std::uint32_t n)
+{
+    auto &table = unique[nodes[n].var];
+    if (table.keys >= 2 * table.buckets.size()) {
+        std::vector<std::uint32_t> old(table.buckets.size() * 2, 0);
+        old.swap(table.buckets);
+        table.keys = 0;
+        for (auto k : old) {
+            while (k) {
+                const auto next = nodes[k].next;
+                insert(k);
+                k = next;
+            }
+        }
+    }
+
+    auto &bucket  = table.buckets[hash(nodes[n].lo, nodes[n].hi) & (table.buckets.size() - 1)];
+    nodes[n].next = bucket;
+    bucket        = n;
+    table.keys++;
+}
+
+void BddManager::unlink(std::uint32_t n)
+{
+    auto &table = unique[nodes[n].var];
+    auto *link  = &table.buckets[hash(nodes[n].lo, nodes[n].hi) & (table.buckets.size() - 1)];
+    while (*link != n) {
+        link = &nodes[*link].next;
+    }
+    *link = nodes[n].next;
+    table.keys--;
+}
+
+void BddManager::ref(Ref r)
+{
+    if (r >> 1 && nodes[r >> 1].refs++ == 0) {
+        dead--;
+    }
+}
+
+void BddManager::deref(Ref r)
+{
+    if (r >> 1 && --nodes[r >> 1].refs == 0) {
+        dead++;
+    }
+}
+
+void BddManager::release(Ref r)
+{
+    if (!(r >> 1) || --nodes[r >> 1].refs) {
+        return;
+    }
+
+    std::vector<std::uint32_t> stack{ r >> 1 };
+    reclaim(stack);
+}
+
+void BddManager::reclaim(std::vector<std::uint32_t> &stack)
+{
+    while (!stack.empty()) {
+        const auto n = stack.back();
+        stack.pop_back();
+        unlink(n);
+        for (const auto child : { nodes[n].lo >> 1, nodes[n].hi >> 1 }) {
+            if (child && --nodes[child].refs == 0) {
+                stack.push_back(child);
+            }
+        }
+        nodes[n].var = Free;
+        freelist.push_back(n);
+        live--;
+    }
+}
+
+void BddManager::prepare()
+{
+    if (dead > (1 << 12) && 2 * dead > live) {
+        collect();
+    }
+    if (auto_reorder && live > reorder_at) {
+        reorder();
+        reorder_at = std::max(reorder_at, 2 * live);
+    }
+    if (cache.size() < live && cache.size() < (1 << 22)) {
+        cache.assign(cache.size() * 2, {});
+    }
+}
+
+void BddManager::collect()
+{
+    std::vector<std::uint32_t> stack;
+    for (std::uint32_t n = 1; n < nodes.size(); n++) {
+        if (nodes[n].var != Free && nodes[n].refs == 0) {
+            stack.push_back(n);
+        }
+    }
+    reclaim(stack);
+    dead = 0;
+    st.collections++;
+    clear_cache();
+}
+
+void BddManager::clear_cache()
+{
+    std::fill(begin(cache), end(cache), Entry{});
+}
+
+void BddManager::reorder()
+{
+    // Sifting only counts nodes that are alive, the computed table is emptied by collect
+    collect();
+
+    std::vector<std::uint32_t> order(var_at.size());
+    std::iota(begin(order), end(order), 0);
+    std::stable_sort(begin(order), end(order), [this](auto a, auto b) { return unique[a].keys > unique[b].keys; });
+    for (const auto var : order) {
+        sift(var);
+    }
+    st.reorderings++;
+}
+
+// Moves var through all levels, towards the nearer end first, and leaves it at the level
+// with the fewest nodes. A direction is given up once the pool grew by a fifth.
+void BddManager::sift(std::uint32_t var)
+{
+    const auto levels = static_cast<std::uint32_t>(var_at.size());
+    auto       best   = live;
+    auto       target = level_of[var];
+
+    const auto moved = [&] {
+        if (live < best) {
+            best   = live;
+            target = level_of[var];
+        }
+        return live <= best + best / 5;
+    };
+    const auto down = [&] {
+        while (level_of[var] + 1 < levels) {
+            swap(level_of[var]);
+            if (!moved()) {
+                break;
+            }
+        }
+    };
+    const auto up = [&] {
+        while (level_of[var] > 0) {
+            swap(level_of[var] - 1);
+            if (!moved()) {
+                break;
+            }
+        }
+    };
+
+    if (2 * level_of[var] >= levels) {
+        down();
+        up();
+    } else {
+        up();
+        down();
+    }
+    while (level_of[var] < target) {
+        swap(level_of[var]);
+    }
+    while (level_of[var] > target) {
+        swap(level_of[var] - 1);
+    }
+}
+
+// Nodes of x that do not depend on y keep their var and move down a level. The others are
+// rewritten in place to test y first, so references to them stay valid:
+// (x, (y, f00, f01), (y, f10, f11)) becomes (y, (x, f00, f10), (x, f01, f11)).
+void BddManager::swap(std::uint32_t level)
+{
+    const auto x = var_at[level];
+    const auto y = var_at[level + 1];
+
+    std::vector<std::uint32_t> xs;
+    for (auto &bucket : unique[x].buckets) {
+        for (auto n = bucket; n; n = nodes[n].next) {
+            xs.push_back(n);
+        }
+        bucket = 0;
+    }
+    unique[x].keys = 0;
+
+    var_at[level]     = y;
+    var_at[level + 1] = x;
+    level_of[y]       = level;
+    level_of[x]       = level + 1;
+
+    std::vector<std::uint32_t> rewrite;
+    for (const auto n : xs) {
+        if (nodes[nodes[n].lo >> 1].var == y || nodes[nodes[n].hi >> 1].var == y) {
+            rewrite.push_back(n);
+        } else {
+            insert(n);
+        }
+    }
+
+    for (const auto n : rewrite) {
+        const auto f0 = nodes[n].lo;
+        const auto f1 = nodes[n].hi;
+        Ref        f00, f01, f10, f11;
+        cofactors(f0, y, f00, f01);
+        cofactors(f1, y, f10, f11);
+
+        const auto lo = make(x, f00, f10);
+        ref(lo);
+        const auto hi = make(x, f01, f11);
+        ref(hi);
+
+        nodes[n].var = y;
+        nodes[n].lo  = lo;
+        nodes[n].hi  = hi;
+        insert(n);
+        release(f0);
+        release(f1);
+    }
+}
+
+std::size_t BddManager::size(const Bdd &f) const
+{
+    std::vector<std::uint8_t>  seen(nodes.size(), 0);
+    std::vector<std::uint32_t> stack{ f.ref >> 1 };
+    std::size_t                count = 0;
+    while (!stack.empty()) {
+        const auto n = stack.back();
+        stack.pop_back();
+        if (seen[n]) {
+            continue;
+        }
+        seen[n] = 1;
+        count++;
+        if (n) {
+            stack.push_back(nodes[n].lo >> 1);
+            stack.push_back(nodes[n].hi >> 1);
+        }
+    }
+    return count;
+}
+
+std::vector<AtomId> BddManager::order() const
+{
+    std::vector<AtomId> out;
+    for (const auto var : var_at) {
+        out.push_back(atoms[var]);
+    }
+    return out;
+}
+
+Natural BddManager::count(const Bdd &f, const std::vector<AtomId> &over) const
+{
+    // below[l]: atoms counted at level l or further down
+    const auto               levels  = var_at.size();
+    std::size_t              outside = 0;
+    std::vector<std::size_t> below(levels + 1, 0);
+    for (const auto atom : over) {
+        if (const auto it = vars.find(atom); it != end(vars)) {
+            below[level_of[it->second]] = 1;
+        } else {
+            outside++;
+        }
+    }
+    for (auto l = levels; l-- > 0;) {
+        below[l] += below[l + 1];
+    }
+
+    // Models and countermodels of each regular node over the atoms from its level down,
+    // a complement edge swaps the two
+    std::unordered_map<std::uint32_t, std::pair<Natural, Natural>> memo;
+
+    const auto counts = [&](auto &self, Ref r) -> std::pair<Natural, Natural> {
+        if (!(r >> 1)) {
+            return r ? std::pair<Natural, Natural>{ 0, 1 } : std::pair<Natural, Natural>{ 1, 0 };
+        }
+        auto it = memo.find(r >> 1);
+        if (it == end(memo)) {
+            const auto                  node = nodes[r >> 1];
+            std::pair<Natural, Natural> sum;
+            for (const auto child : { node.lo, node.hi }) {
+                auto       part = self(self, child);
+                const auto skip = below[level_of[node.var] + 1] - below[level(child)];
+                part.first <<= skip;
+                part.second <<= skip;
+                sum.first += part.first;
+                sum.second += part.second;
+            }
+            it = memo.emplace(r >> 1, std::move(sum)).first;
+        }
+        return r & 1 ? std::make_pair(it->second.second, it->second.first) : it->second;
+    };
+
+    auto n = counts(counts, f.ref).first;
+    n <<= below[0] - below[level(f.ref)] + outside;
+    return n;
+}
+
+void BddManager::paths(const Bdd &f, const std::function<void(const Cube &)> &visit) const
+{
+    Cube       cube;
+    const auto walk = [&](auto &self, Ref r) -> void {
+        if (r == 1) {
+            return;
+        }
+        if (r == 0) {
+            visit(cube);
+            return;
+        }
+        const auto var = nodes[r >> 1].var;
+        Ref        lo, hi;
+        cofactors(r, var, lo, hi);
+        cube.emplace_back(atoms[var], true);
+        self(self, hi);
+        cube.back().second = false;
+        self(self, lo);
+        cube.pop_back();
+    };
+    walk(walk, f.ref);
+}
+
+Bdd make_bdd(BddManager &mgr, const ExpressionStore &store, ExprId expr)
+{
+    ProfileScope scope("bdd");
+
+    // Number of parents of every reachable node, a node's BDD is dropped after its last
+    // parent used it. Atoms get their variables in preorder.
+    std::unordered_map<ExprId, std::uint32_t> parents;
+    store.visit(expr, [&](ExprId e, const Expression &node) {
+        if (node.op == Expression::Pred && !parents.count(e)) {
+            mgr.var(node.lhs);
+        }
+        return parents[e]++ == 0;
+    });
+
+    std::vector<ExprId> order;
+    for (const auto &[e, count] : parents) {
+        order.push_back(e);
+    }
+    std::sort(begin(order), end(order));
+
+    std::unordered_map<ExprId, Bdd> built;
+
+    const auto use = [&](ExprId e) {
+        const auto it = built.find(e);
+        Bdd        b  = it->second;
+        if (--parents[e] == 0) {
+            built.erase(it);
+        }
+        return b;
+    };
+
+    // Ids are a topological order, children are built before their parents
+    for (const auto e : order) {
+        const auto &node = store[e];
+        Bdd         b;
+        switch (node.op) {
+        case Expression::Constant:
+            b = mgr.constant(node.lhs);
+            break;
+        case Expression::Pred:
+            b = mgr.var(node.lhs);
+            break;
+        case Expression::Neg:
+            b = !use(node.lhs);
+            break;
+        default: {
+            const auto lhs = use(node.lhs);
+            const auto rhs = use(node.rhs);
+            switch (node.op) {
+            case Expression::And:
+                b = mgr.conj(lhs, rhs);
+                break;
+            case Expression::Or:
+                b = mgr.disj(lhs, rhs);
+                break;
+            case Expression::Impl:
+                b = mgr.implies(lhs, rhs);
+                break;
+            default:
+                b = mgr.equiv(lhs, rhs);
+                break;
+            }
+        }
+        }
+        built.emplace(e, std::move(b));
+    }
+    scope.counter("nodes", mgr.size());
+    return use(expr);
+}
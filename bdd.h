@@ -0,0 +1,155 @@
+#pragma once
+#include "ast.h"
+#include "natural.h"
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class BddManager;
+
+// Reference to a BDD node that keeps the node alive while it exists. Two handles of the
+// same manager are equal iff they denote the same boolean function.
+class Bdd {
+public:
+    Bdd() = default;
+    Bdd(const Bdd &other);
+    Bdd(Bdd &&other) noexcept;
+    Bdd &operator=(Bdd other) noexcept;
+    ~Bdd();
+
+    Bdd operator!() const;
+
+    bool operator==(const Bdd &other) const { return ref == other.ref; }
+    bool operator!=(const Bdd &other) const { return ref != other.ref; }
+
+    bool tautology() const { return ref == 0; }
+    bool unsat() const { return ref == 1; }
+
+private:
+    friend class BddManager;
+
+    Bdd(BddManager *mgr, std::uint32_t ref);
+
+    BddManager *  mgr = nullptr;
+    std::uint32_t ref = 1;
+};
+
+// Reduced ordered BDDs with complement edges. A reference is a node index shifted left by
+// one with the complement flag in the low bit, node 0 is the terminal, so reference 0 is tt
+// and 1 is ff. The then edge of a node is never complemented, which keeps the
+// representation canonical.
+//
+// Nodes are hash consed in one unique table per variable and results of ite are memoized
+// in a direct mapped computed table. Nodes are reference counted, nodes whose count drops
+// to zero stay in the unique table until the next collection, which runs between
+// operations once they make up half of the pool. Growing past a threshold also reorders
+// the variables by sifting. Both keep every live reference valid.
+class BddManager {
+public:
+    struct Stats {
+        std::uint64_t lookups     = 0; // computed table
+        std::uint64_t hits        = 0;
+        std::uint64_t collections = 0;
+        std::uint64_t reorderings = 0;
+        std::size_t   peak        = 0; // most nodes alive at once
+    };
+
+    using Cube = std::vector<std::pair<AtomId, bool>>;
+
+    BddManager();
+
+    Bdd constant(bool value) { return { this, value ? 0u : 1u }; }
+    Bdd var(AtomId atom); // new atoms are ordered below the existing ones
+
+    Bdd ite(const Bdd &f, const Bdd &g, const Bdd &h);
+    Bdd conj(const Bdd &f, const Bdd &g) { return ite(f, g, constant(false)); }
+    Bdd disj(const Bdd &f, const Bdd &g) { return ite(f, constant(true), g); }
+    Bdd implies(const Bdd &f, const Bdd &g) { return ite(f, g, constant(true)); }
+    Bdd equiv(const Bdd &f, const Bdd &g) { return ite(f, g, !g); }
+
+    void reorder(); // sifts every variable once
+    bool auto_reorder = true;
+
+    std::size_t         size() const { return live; }
+    std::size_t         size(const Bdd &f) const; // nodes reachable from f, terminal included
+    std::vector<AtomId> order() const; // atoms from the top level down
+    const Stats &       stats() const { return st; }
+
+    // Satisfying assignments of f to atoms, which have to include every atom f depends on
+    Natural count(const Bdd &f, const std::vector<AtomId> &atoms) const;
+
+    // Calls visit with the cube of every path from f to tt, then edges before else edges
+    void paths(const Bdd &f, const std::function<void(const Cube &)> &visit) const;
+
+private:
+    friend class Bdd;
+
+    using Ref = std::uint32_t;
+
+    static constexpr std::uint32_t Terminal = UINT32_MAX; // var of node 0
+    static constexpr std::uint32_t Free     = UINT32_MAX - 1; // var of nodes on the free list
+
+    struct Node {
+        std::uint32_t var;
+        Ref           lo, hi;
+        std::uint32_t next; // chain in the unique table, 0 ends it
+        std::uint32_t refs;
+    };
+
+    struct Subtable {
+        std::vector<std::uint32_t> buckets;
+        std::size_t                keys = 0;
+    };
+
+    struct Entry {
+        Ref f = UINT32_MAX, g, h, r;
+    };
+
+    Ref  ite(Ref f, Ref g, Ref h);
+    Ref  make(std::uint32_t var, Ref lo, Ref hi);
+    void insert(std::uint32_t n);
+    void unlink(std::uint32_t n);
+    void ref(Ref r);
+    void deref(Ref r);
+    void release(Ref r); // deref that frees the node and its dead descendants right away
+    void reclaim(std::vector<std::uint32_t> &stack); // frees the unreferenced nodes on stack and whatever dies with them
+    void prepare(); // collection and reordering, only between operations
+    void collect();
+    void clear_cache();
+    void swap(std::uint32_t level); // exchanges the variables of level and level + 1
+    void sift(std::uint32_t var);
+
+    std::uint32_t level(Ref r) const
+    {
+        const auto var = nodes[r >> 1].var;
+        return var == Terminal ? static_cast<std::uint32_t>(var_at.size()) : level_of[var];
+    }
+    void cofactors(Ref r, std::uint32_t var, Ref &lo, Ref &hi) const
+    {
+        const auto &node = nodes[r >> 1];
+        if (node.var == var) {
+            lo = node.lo ^ (r & 1);
+            hi = node.hi ^ (r & 1);
+        } else {
+            lo = hi = r;
+        }
+    }
+
+    std::vector<Node>          nodes;
+    std::vector<std::uint32_t> freelist;
+    std::vector<Subtable>      unique; // indexed by variable
+    std::vector<Entry>         cache;
+
+    std::vector<AtomId>                       atoms; // of each variable
+    std::unordered_map<AtomId, std::uint32_t> vars;
+    std::vector<std::uint32_t>                level_of, var_at;
+    std::size_t                               live = 0, dead = 0; // nodes in use, of those unreferenced
+    std::size_t                               reorder_at = 1 << 14;
+    Stats                                     st;
+};
+
+// BDD of expr, variables are created in the order the atoms first occur in expr
+Bdd make_bdd(BddManager &mgr, const ExpressionStore &store, ExprId expr);
@@ -0,0 +1,279 @@
+// Benchmarks every stage of the pipeline on generated formula families and reports
+// time, throughput, allocations and peak RSS per stage as JSON on stdout.
+//
+// usage: satsolver_bench [--family name] [--seed n]
+
+#include "ast.h"
+#include "clauses.h"
+#include "cnf.h"
+#include "localsearch.h"
+#include "parser.hpp"
+#include "profile.h"
+#include "proof.h"
+#include "solver.h"
+#include "truthtable.h"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// A generated instance, text in the script language of satsolver
+struct Instance {
+    std::string family;
+    std::string params; // JSON object members describing the instance
+    std::string text;
+    bool        knf; // make_knf stays polynomial on this family
+};
+
+std::string var(const char *prefix, int i) { return prefix + std::to_string(i); }
+
+// Join terms with op, parenthesized so the nesting does not depend on operator precedence
+std::string join(const std::vector<std::string> &terms, const char *op)
+{
+    std::string out;
+    for (std::size_t i = 0; i < terms.size(); i++) {
+        out += i ? std::string(" ") + op + " " : "";
+        out += "(" + terms[i] + ")";
+    }
+    return out;
+}
+
+Instance random_ksat(std::mt19937 &rng, int k, int vars, double ratio)
+{
+    const int                clauses = static_cast<int>(vars * ratio);
+    std::vector<std::string> cs;
+    for (int c = 0; c < clauses; c++) {
+        std::vector<std::string> lits;
+        for (int i = 0; i < k; i++) {
+            const auto v = var("x", 1 + rng() % vars);
+            lits.push_back(rng() % 2 ? v : "not " + v);
+        }
+        cs.push_back(join(lits, "or"));
+    }
+    char params[128];
+    snprintf(params, sizeof(params), "\"k\": %d, \"vars\": %d, \"clauses\": %d, \"ratio\": %.2f", k, vars, clauses, ratio);
+    return { "random-ksat", params, join(cs, "and"), true };
+}
+
+// n + 1 pigeons in n holes, p_i_j says pigeon i sits in hole j
+Instance pigeonhole(int holes)
+{
+    const auto               p = [](int i, int j) { return "p" + std::to_string(i) + "h" + std::to_string(j); };
+    std::vector<std::string> cs;
+    for (int i = 0; i <= holes; i++) {
+        std::vector<std::string> somewhere;
+        for (int j = 0; j < holes; j++) {
+            somewhere.push_back(p(i, j));
+        }
+        cs.push_back(join(somewhere, "or"));
+    }
+    for (int j = 0; j < holes; j++) {
+        for (int i = 0; i <= holes; i++) {
+            for (int k = i + 1; k <= holes; k++) {
+                cs.push_back("not " + p(i, j) + " or not " + p(k, j));
+            }
+        }
+    }
+    return { "pigeonhole", "\"holes\": " + std::to_string(holes), join(cs, "and"), true };
+}
+
+// x1 ⊕ ... ⊕ xn, xor written as the negated biconditional
+Instance parity(int n)
+{
+    std::string f = var("x", 1);
+    for (int i = 2; i <= n; i++) {
+        f = "not ((" + f + ") <-> " + var("x", i) + ")";
+    }
+    return { "parity", "\"vars\": " + std::to_string(n), f, n <= 5 };
+}
+
+// x1 <-> x2 <-> ... <-> xn
+Instance biconditionals(int n)
+{
+    std::string f = var("x", 1);
+    for (int i = 2; i <= n; i++) {
+        f += " <-> " + var("x", i);
+    }
+    return { "biconditional-chain", "\"vars\": " + std::to_string(n), f, n <= 5 };
+}
+
+// x1 -> x2 -> ... -> xn, nested to the right and n levels deep
+Instance implications(int n)
+{
+    std::string f = var("x", 1);
+    for (int i = 2; i <= n; i++) {
+        f += " -> " + var("x", i);
+    }
+    return { "implication-chain", "\"vars\": " + std::to_string(n), f, true };
+}
+
+std::vector<Instance> instances(std::mt19937 &rng)
+{
+    std::vector<Instance> list;
+    for (const double ratio : { 3.0, 4.26, 5.0 }) {
+        list.push_back(random_ksat(rng, 3, 150, ratio));
+    }
+    list.push_back(random_ksat(rng, 3, 4000, 3.0));
+    list.push_back(random_ksat(rng, 5, 60, 21.0));
+    for (const int holes : { 5, 7 }) {
+        list.push_back(pigeonhole(holes));
+    }
+    for (const int n : { 5, 1000 }) {
+        list.push_back(parity(n));
+        list.push_back(biconditionals(n));
+    }
+    for (const int n : { 20, 2000 }) {
+        list.push_back(implications(n));
+    }
+    return list;
+}
+
+long peak_rss_kb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Times one stage and prints it as a member of the "stages" object, work / seconds is the throughput
+class Stages {
+public:
+    void run(const char *name, const char *unit, const std::function<double()> &stage)
+    {
+        const auto allocs = Profiler::global().allocation_count();
+        const auto start  = std::chrono::steady_clock::now();
+        const auto work   = stage();
+        const auto ms     = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%s\n        \"%s\": { \"ms\": %.3f, \"throughput\": %.0f, \"unit\": \"%s\", \"allocations\": %llu, \"peak_rss_kb\": %ld }",
+               first ? "" : ",", name, ms, ms > 0 ? work / ms * 1000 : 0, unit,
+               static_cast<unsigned long long>(Profiler::global().allocation_count() - allocs), peak_rss_kb());
+        first = false;
+    }
+
+private:
+    bool first = true;
+};
+
+void bench(const Instance &instance, bool first)
+{
+    ExpressionStore store;
+    ExprId          expr = NoExpr;
+    const auto      script = "print " + instance.text + ";";
+
+    printf("%s\n    { \"family\": \"%s\", \"params\": { %s },\n      \"stages\": {", first ? "" : ",", instance.family.c_str(),
+           instance.params.c_str());
+
+    Stages stages;
+    stages.run("parse", "bytes/s", [&] {
+        StatementList statements;
+        parse_script(script, store, statements);
+        expr = statements.statements.back()->expression();
+        return static_cast<double>(script.size());
+    });
+    const auto nodes = store.size();
+    const auto atoms = store.atoms(expr).size();
+
+    stages.run("nnf", "nodes/s", [&] {
+        make_nnf(store, expr);
+        return static_cast<double>(nodes);
+    });
+    if (instance.knf) {
+        stages.run("knf", "nodes/s", [&] {
+            make_knf(store, expr);
+            return static_cast<double>(nodes);
+        });
+        stages.run("clauses", "nodes/s", [&] {
+            make_clauses(store, expr);
+            return static_cast<double>(nodes);
+        });
+    }
+    if (atoms <= 24) {
+        stages.run("table", "rows/s", [&] {
+            TruthTable table(store, store.atoms(expr), { expr });
+            for (std::uint64_t b = 0; b < table.blocks(); b++) {
+                table.eval(b);
+            }
+            return static_cast<double>(table.rows());
+        });
+    }
+
+    sat::Result result = sat::Result::Unknown;
+    Cnf         cnf;
+    stages.run("tseitin", "clauses/s", [&] {
+        cnf = tseitin_clauses(store, expr);
+        return static_cast<double>(cnf.size());
+    });
+    stages.run("solve", "conflicts/s", [&] {
+        sat::Solver solver;
+        add_clauses(solver, cnf);
+        result = solver.solve();
+        return static_cast<double>(solver.stats().conflicts);
+    });
+    // The same with binary proofs going to /dev/null, what logging costs the solver
+    for (const auto format : { ProofFormat::Drat, ProofFormat::Lrat }) {
+        stages.run(format == ProofFormat::Drat ? "solve_drat" : "solve_lrat", "conflicts/s", [&] {
+            FILE *      null = fopen("/dev/null", "w");
+            ProofWriter proof(null, format, true);
+            sat::Solver solver;
+            solver.prove(&proof, cnf.size());
+            add_clauses(solver, cnf);
+            solver.solve();
+            proof.finish();
+            fclose(null);
+            return static_cast<double>(solver.stats().conflicts);
+        });
+    }
+    // Local search on the KNF, only where it can succeed
+    if (instance.knf && result == sat::Result::Sat) {
+        const auto clauses = make_clauses(store, expr).cnf();
+        stages.run("walk", "flips/s", [&] {
+            return static_cast<double>(local_search(clauses, WalkOptions{}).flips);
+        });
+    }
+
+    printf("\n      },\n      \"nodes\": %zu, \"atoms\": %zu, \"clauses\": %zu, \"result\": \"%s\" }", nodes, atoms, cnf.size(),
+           result == sat::Result::Sat ? "sat" : result == sat::Result::Unsat ? "unsat" : "unknown");
+    fflush(stdout);
+}
+}
+
+int main(int argc, char **argv)
+{
+    const char * family = nullptr;
+    unsigned int seed   = 1;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--family") == 0 && i + 1 < argc) {
+            family = argv[++i];
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            fprintf(stderr, "usage: %s [--family name] [--seed n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Profiler::global().count_allocations();
+
+    std::mt19937 rng(seed);
+    bool         first = true;
+    printf("{ \"seed\": %u, \"benchmarks\": [", seed);
+    for (auto &&instance : instances(rng)) {
+        if (family && instance.family != family) {
+            continue;
+        }
+        bench(instance, first);
+        first = false;
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
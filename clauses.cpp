@@ -0,0 +1,292 @@
+#include "clauses.h"
+#include "profile.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+ClauseStore::ClauseStore(const Cnf &cnf, const std::vector<AtomId> &atoms)
+{
+    std::vector<sat::Lit> lits;
+    for (std::size_t c = 0; c < cnf.size(); c++) {
+        lits.clear();
+        for (const auto l : cnf[c]) {
+            lits.push_back(sat::mklit(atoms[sat::var(l)], sat::sign(l)));
+        }
+        add(lits);
+    }
+}
+
+std::size_t ClauseStore::hash(const sat::Lit *first, const sat::Lit *last)
+{
+    std::uint64_t h = 0xcbf29ce484222325ull ^ static_cast<std::uint64_t>(last - first);
+    for (; first != last; ++first) {
+        h = (h ^ *first) * 0x100000001b3ull;
+        h ^= h >> 29;
+    }
+    return static_cast<std::size_t>(h);
+}
+
+std::size_t ClauseStore::slot(const sat::Lit *first, const sat::Lit *last, std::size_t h) const
+{
+    const auto mask = table.size() - 1;
+    const auto size = static_cast<std::size_t>(last - first);
+    for (auto i = h & mask;; i = (i + 1) & mask) {
+        const auto ref = table[i];
+        if (ref == Empty || (arena[ref] == size && std::equal(first, last, arena.data() + ref + 1))) {
+            return i;
+        }
+    }
+}
+
+void ClauseStore::rehash(std::size_t capacity)
+{
+    table.assign(capacity, Empty);
+    for_each([&](Ref ref, Clause clause) { table[slot(clause.begin(), clause.end(), hash(clause.begin(), clause.end()))] = ref; });
+}
+
+bool ClauseStore::add(std::vector<sat::Lit> &lits)
+{
+    std::sort(begin(lits), end(lits));
+    lits.erase(std::unique(begin(lits), end(lits)), end(lits));
+    // Sorted, l and ¬l are neighbours
+    for (std::size_t i = 1; i < lits.size(); i++) {
+        if (lits[i] == sat::neg(lits[i - 1])) {
+            return false;
+        }
+    }
+
+    if (2 * (clauses + 1) > table.size()) {
+        rehash(std::max<std::size_t>(16, 2 * table.size()));
+    }
+    const auto first = lits.data();
+    const auto last  = first + lits.size();
+    const auto i     = slot(first, last, hash(first, last));
+    if (table[i] != Empty) {
+        return false;
+    }
+    table[i] = static_cast<Ref>(arena.size());
+    arena.push_back(static_cast<sat::Lit>(lits.size()));
+    arena.insert(end(arena), first, last);
+    clauses++;
+    return true;
+}
+
+bool ClauseStore::eval(const EvaluationContext &ec) const
+{
+    bool result = true;
+    for_each([&](Ref, Clause clause) {
+        result = result && std::any_of(clause.begin(), clause.end(), [&](sat::Lit l) { return ec.get(sat::var(l)) != sat::sign(l); });
+    });
+    return result;
+}
+
+void ClauseStore::print(const ExpressionStore &store, FILE *out) const
+{
+    if (clauses == 0) {
+        fprintf(out, "tt");
+    }
+    bool first = true;
+    for_each([&](Ref, Clause clause) {
+        fprintf(out, "%s(", first ? "" : " ∧ ");
+        if (clause.empty()) {
+            fprintf(out, "ff");
+        }
+        for (std::size_t i = 0; i < clause.size(); i++) {
+            fprintf(out, "%s%s%s", i ? " ∨ " : "", sat::sign(clause[i]) ? "¬" : "", store.name(sat::var(clause[i])).c_str());
+        }
+        fprintf(out, ")");
+        first = false;
+    });
+}
+
+Cnf ClauseStore::cnf(std::vector<AtomId> *atoms) const
+{
+    Cnf                   cnf;
+    std::vector<sat::Lit> lits;
+    for_each([&](Ref, Clause clause) {
+        lits.clear();
+        for (const auto l : clause) {
+            const auto v = cnf.atom(sat::var(l));
+            if (atoms && v == atoms->size()) {
+                atoms->push_back(sat::var(l));
+            }
+            lits.push_back(sat::mklit(v, sat::sign(l)));
+        }
+        cnf.add_clause(lits);
+    });
+    cnf.inputs = cnf.atoms.size();
+    return cnf;
+}
+
+ExprId ClauseStore::expression(ExpressionStore &store) const
+{
+    ExprId knf = NoExpr;
+    for_each([&](Ref, Clause clause) {
+        ExprId disjunction = NoExpr;
+        for (const auto l : clause) {
+            auto lit = store.pred(sat::var(l));
+            if (sat::sign(l)) {
+                lit = store.neg(lit);
+            }
+            disjunction = disjunction == NoExpr ? lit : store.binary(Expression::Or, disjunction, lit);
+        }
+        if (disjunction == NoExpr) {
+            disjunction = store.constant(false);
+        }
+        knf = knf == NoExpr ? disjunction : store.binary(Expression::And, knf, disjunction);
+    });
+    return knf == NoExpr ? store.constant(true) : knf;
+}
+
+// Operands of a chain of one operator, And and Or nodes of an NNF are n-ary
+static void flatten(const ExpressionStore &store, ExprId e, std::vector<ExprId> &out)
+{
+    const auto          op = store[e].op;
+    std::vector<ExprId> pending{ e };
+    while (!pending.empty()) {
+        const auto next = pending.back();
+        pending.pop_back();
+        const auto &node = store[next];
+        if (node.op == op) {
+            pending.push_back(node.rhs);
+            pending.push_back(node.lhs);
+        } else {
+            out.push_back(next);
+        }
+    }
+}
+
+// Clauses of a ∨ b: the union of every clause of a with every clause of b
+static ClauseStore product(const ClauseStore &a, const ClauseStore &b, std::vector<sat::Lit> &lits)
+{
+    ClauseStore out;
+    a.for_each([&](ClauseStore::Ref, Clause x) {
+        b.for_each([&](ClauseStore::Ref, Clause y) {
+            lits.assign(x.begin(), x.end());
+            lits.insert(end(lits), y.begin(), y.end());
+            out.add(lits);
+        });
+    });
+    return out;
+}
+
+ClauseStore make_clauses(ExpressionStore &store, ExprId input)
+{
+    ProfileScope scope("make_clauses");
+    const auto   nnf  = make_nnf(store, input);
+    const auto   gate = [&](ExprId e) { return store[e].op == Expression::And || store[e].op == Expression::Or; };
+
+    // Literals and constants never get a set of their own, the chains containing them add
+    // them directly. So does a formula that is nothing else.
+    const auto root = gate(nnf) ? nnf : store.binary(Expression::And, nnf, store.constant(true));
+
+    // Counts how many chains take each subformula as an operand, its clauses are dropped
+    // once the last of them is done
+    std::unordered_map<ExprId, std::uint32_t> uses;
+    std::vector<ExprId>                       operands;
+    Traversal<ExprId>                         traversal;
+    traversal.run(
+        root,
+        [&](ExprId e, const auto &push) {
+            if (uses[e]++) {
+                return false;
+            }
+            operands.clear();
+            flatten(store, e, operands);
+            for (const auto o : operands) {
+                if (gate(o)) {
+                    push(o);
+                }
+            }
+            return true;
+        },
+        [](ExprId) {});
+
+    std::unordered_map<ExprId, ClauseStore> sets;
+    std::vector<sat::Lit>                   lits, clause;
+    const auto take = [&](ExprId e) -> ClauseStore {
+        const auto it = sets.find(e);
+        if (--uses[e]) {
+            return it->second;
+        }
+        auto set = std::move(it->second);
+        sets.erase(it);
+        return set;
+    };
+    traversal.run(
+        root,
+        [&](ExprId e, const auto &push) {
+            if (sets.count(e)) {
+                return false;
+            }
+            operands.clear();
+            flatten(store, e, operands);
+            for (const auto o : operands) {
+                if (gate(o)) {
+                    push(o);
+                }
+            }
+            return true;
+        },
+        [&](ExprId e) {
+            const bool conjunction = store[e].op == Expression::And;
+            operands.clear();
+            flatten(store, e, operands);
+
+            // The literals of a disjunction form one clause every other clause is joined with,
+            // in a conjunction each is a unit clause. Only atoms and constants are negated in an
+            // NNF, tt satisfies a disjunction and ff empties a conjunction, the others are dropped.
+            bool satisfied = false;
+            clause.clear();
+            ClauseStore set;
+            for (const auto o : operands) {
+                const auto &node    = store[o];
+                const bool  negated = node.op == Expression::Neg;
+                const auto &atom    = negated ? store[node.lhs] : node;
+                if (gate(o)) {
+                    continue;
+                } else if (atom.op == Expression::Constant) {
+                    const bool value = (atom.lhs != 0) != negated;
+                    satisfied |= !conjunction && value;
+                    if (conjunction && !value) {
+                        lits.clear();
+                        set.add(lits);
+                    }
+                } else {
+                    const auto lit = sat::mklit(atom.lhs, negated);
+                    if (conjunction) {
+                        lits.assign(1, lit);
+                        set.add(lits);
+                    } else {
+                        clause.push_back(lit);
+                    }
+                }
+            }
+            if (!conjunction && !satisfied) {
+                set.add(clause);
+            }
+
+            for (const auto o : operands) {
+                if (!gate(o)) {
+                    continue;
+                }
+                const auto next = take(o);
+                if (satisfied) {
+                    continue;
+                } else if (conjunction) {
+                    next.for_each([&](ClauseStore::Ref, Clause c) {
+                        lits.assign(c.begin(), c.end());
+                        set.add(lits);
+                    });
+                } else {
+                    set = product(set, next, lits);
+                }
+            }
+            sets.emplace(e, std::move(set));
+        });
+
+    auto result = std::move(sets.at(root));
+    scope.counter("clauses", result.size());
+    scope.counter("literals", result.literals());
+    return result;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "ast.h"
+#include "cnf.h"
+#include "solver.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Clauses over atoms packed into one array, each its size followed by its literals. Literal
+// sat::mklit(atom) stands for the atom itself, so a store needs no variable mapping and
+// evaluates against an EvaluationContext directly.
+//
+// The size is the whole header. Clauses are never deleted or ranked here, the solver keeps
+// flags and activities of its own clauses, so a store has no use for either.
+//
+// add() sorts a clause and drops repeated literals. Tautologies are not added, neither are
+// clauses already stored, which an open addressing table over the hashes of the sorted
+// literals finds. Iterating the clauses is one scan over the array.
+class ClauseStore {
+public:
+    using Ref = std::uint32_t; // offset of the size of a clause in the array
+
+    ClauseStore() = default;
+    // Clauses of cnf, variable v stands for atoms[v]
+    ClauseStore(const Cnf &cnf, const std::vector<AtomId> &atoms);
+
+    // Sorts lits in place. False if the clause was a tautology or is already stored.
+    bool add(std::vector<sat::Lit> &lits);
+
+    std::size_t size() const { return clauses; }
+    std::size_t literals() const { return arena.size() - clauses; }
+
+    // Calls f(ref, clause) for every clause, in the order they were added
+    template<typename F>
+    void for_each(F &&f) const
+    {
+        for (std::size_t r = 0; r < arena.size();) {
+            const auto size  = arena[r];
+            const auto first = arena.data() + r + 1;
+            f(static_cast<Ref>(r), Clause{ first, first + size });
+            r += 1 + size;
+        }
+    }
+
+    bool eval(const EvaluationContext &ec) const;
+    // (a ∨ ¬b) ∧ (c) like print_cnf, tt without clauses
+    void print(const ExpressionStore &store, FILE *out) const;
+
+    // Variables numbered in the order the atoms first occur, atoms gets the atom of each
+    Cnf cnf(std::vector<AtomId> *atoms = nullptr) const;
+    // The tree form, a conjunction of disjunctions in clause order
+    ExprId expression(ExpressionStore &store) const;
+
+private:
+    static constexpr Ref Empty = UINT32_MAX;
+
+    static std::size_t hash(const sat::Lit *first, const sat::Lit *last);
+
+    // Slot of the clause equal to [first, last) or the slot to insert it into
+    std::size_t slot(const sat::Lit *first, const sat::Lit *last, std::size_t h) const;
+    void        rehash(std::size_t capacity);
+
+    std::vector<sat::Lit> arena;
+    std::vector<Ref>      table; // clauses, capacity a power of two
+    std::size_t           clauses = 0;
+};
+
+// KNF of input as clauses, without the tree make_knf builds. The NNF is distributed over
+// sets of clauses instead of subformulas, every intermediate set already free of
+// tautologies and duplicates, and the set of a subformula is released once every formula
+// containing it took its clauses.
+ClauseStore make_clauses(ExpressionStore &store, ExprId input);
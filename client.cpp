@@ -0,0 +1,125 @@
+// Sends the request lines of stdin to satsolver --socket and prints the answers, then
+// round trip latencies on stderr. Replays the requests n times with --repeat, which warms
+// the cache of the server after the first round.
+//
+// usage: satsolver_client [--repeat n] [--quiet] socket
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool send_all(int fd, const std::string &data)
+{
+    for (std::size_t sent = 0; sent < data.size();) {
+        const auto n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+// Answers end with an empty line, input keeps what arrived after it
+bool receive(int fd, std::string &input, std::string &answer)
+{
+    for (;;) {
+        const auto end = input.compare(0, 1, "\n") == 0 ? 0 : input.find("\n\n");
+        if (end != std::string::npos) {
+            const auto length = end ? end + 2 : 1;
+            answer            = input.substr(0, length);
+            input.erase(0, length);
+            return true;
+        }
+        char       chunk[4096];
+        const auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+        input.append(chunk, static_cast<std::size_t>(n));
+    }
+}
+
+double percentile(const std::vector<double> &sorted, double p)
+{
+    return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * sorted.size()))];
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const char *path   = nullptr;
+    long        repeat = 1;
+    bool        quiet  = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1l, std::strtol(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--quiet") == 0) {
+            quiet = true;
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [--repeat n] [--quiet] socket\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "usage: %s [--repeat n] [--quiet] socket\n", argv[0]);
+        return 1;
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        perror(path);
+        return 1;
+    }
+
+    std::vector<std::string> requests;
+    for (std::string line; std::getline(std::cin, line);) {
+        requests.push_back(line + "\n");
+    }
+
+    std::vector<double> latencies; // µs
+    std::string         input, answer;
+    for (long round = 0; round < repeat; round++) {
+        for (const auto &request : requests) {
+            const auto start = std::chrono::steady_clock::now();
+            if (!send_all(fd, request) || !receive(fd, input, answer)) {
+                fprintf(stderr, "%s: connection closed\n", path);
+                return 1;
+            }
+            latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            if (!quiet) {
+                fwrite(answer.data(), 1, answer.size(), stdout);
+            }
+        }
+    }
+    ::close(fd);
+
+    if (!latencies.empty()) {
+        std::sort(begin(latencies), end(latencies));
+        fprintf(stderr, "%zu requests, p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n", latencies.size(), percentile(latencies, 0.5),
+                percentile(latencies, 0.9), percentile(latencies, 0.99), latencies.back());
+    }
+    return 0;
+}
@@ -0,0 +1,258 @@
+#include "cnf.h"
+#include "profile.h"
+
+#include <cstdio>
+
+ExprId knf_expression(ExpressionStore &store, const Cnf &cnf)
+{
+    ExprId knf = NoExpr;
+    for (std::size_t c = 0; c < cnf.size(); c++) {
+        ExprId clause = NoExpr;
+        for (const auto l : cnf[c]) {
+            auto lit = store.pred(cnf.atoms[sat::var(l)]);
+            if (sat::sign(l)) {
+                lit = store.neg(lit);
+            }
+            clause = clause == NoExpr ? lit : store.binary(Expression::Or, clause, lit);
+        }
+        if (clause == NoExpr) {
+            clause = store.constant(false);
+        }
+        knf = knf == NoExpr ? clause : store.binary(Expression::And, knf, clause);
+    }
+    return knf == NoExpr ? store.constant(true) : knf;
+}
+
+static unsigned flip(unsigned polarity)
+{
+    return ((polarity & TseitinEncoder::Positive) << 1) | ((polarity & TseitinEncoder::Negative) >> 1);
+}
+
+TseitinEncoder::TseitinEncoder(const ExpressionStore &store, Cnf &cnf, bool polarity_aware)
+    : store(store)
+    , cnf(cnf)
+    , polarity_aware(polarity_aware)
+{
+}
+
+void TseitinEncoder::assert_true(ExprId expr)
+{
+    std::vector<ExprId> conjuncts, disjuncts;
+    flatten(expr, Expression::And, conjuncts);
+
+    // Top level conjunctions and disjunctions need no auxiliary variables
+    for (const auto c : conjuncts) {
+        disjuncts.clear();
+        flatten(c, Expression::Or, disjuncts);
+
+        std::vector<sat::Lit> clause;
+        for (const auto d : disjuncts) {
+            clause.push_back(encode(d, Positive));
+        }
+        cnf.add_clause(clause);
+    }
+}
+
+sat::Lit TseitinEncoder::encode(ExprId expr, unsigned polarity)
+{
+    traversal.run(
+        { expr, polarity },
+        [&](Pending &item, const auto &push) {
+            bool negated  = false;
+            item.polarity = polarity_aware ? item.polarity : Both;
+            item.expr     = strip(item.expr, item.polarity, negated);
+
+            const auto node = store[item.expr];
+            if (!node.binary()) {
+                literal(item.expr);
+                return false;
+            }
+            if (item.expr >= gates.size()) {
+                gates.resize(store.size(), Gate{ sat::UndefLit, 0 });
+            }
+            auto &g = gates[item.expr];
+            if (g.lit == sat::UndefLit) {
+                g.lit = sat::mklit(cnf.aux());
+            }
+            item.polarity &= ~g.emitted;
+            g.emitted |= item.polarity;
+            if (!item.polarity) {
+                return false;
+            }
+
+            switch (node.op) {
+            case Expression::And:
+            case Expression::Or:
+                operands.clear();
+                flatten(node.lhs, node.op, operands);
+                flatten(node.rhs, node.op, operands);
+                for (const auto o : operands) {
+                    push({ o, item.polarity });
+                }
+                break;
+            case Expression::Impl:
+                push({ node.lhs, flip(item.polarity) });
+                push({ node.rhs, item.polarity });
+                break;
+            default:
+                push({ node.lhs, Both });
+                push({ node.rhs, Both });
+                break;
+            }
+            return true;
+        },
+        [&](const Pending &item) {
+            const auto node    = store[item.expr];
+            const auto x       = gates[item.expr].lit;
+            const auto missing = item.polarity;
+            switch (node.op) {
+            case Expression::And:
+            case Expression::Or:
+                operands.clear();
+                flatten(node.lhs, node.op, operands);
+                flatten(node.rhs, node.op, operands);
+                lits.clear();
+                for (const auto o : operands) {
+                    lits.push_back(literal(o));
+                }
+                gate(x, lits, node.op == Expression::And, missing);
+                break;
+            case Expression::Impl:
+                gate(x, { sat::neg(literal(node.lhs)), literal(node.rhs) }, false, missing);
+                break;
+            default: {
+                const auto a = literal(node.lhs);
+                const auto b = literal(node.rhs);
+                if (missing & Positive) {
+                    cnf.add_clause({ sat::neg(x), sat::neg(a), b });
+                    cnf.add_clause({ sat::neg(x), a, sat::neg(b) });
+                }
+                if (missing & Negative) {
+                    cnf.add_clause({ x, a, b });
+                    cnf.add_clause({ x, sat::neg(a), sat::neg(b) });
+                }
+                break;
+            }
+            }
+        });
+    return literal(expr);
+}
+
+// Literal of an atom, a constant or a subformula encode() already reached
+sat::Lit TseitinEncoder::literal(ExprId expr)
+{
+    unsigned polarity = Both;
+    bool     negated  = false;
+    expr              = strip(expr, polarity, negated);
+
+    const auto &node = store[expr];
+    sat::Lit    lit;
+    if (node.op == Expression::Pred) {
+        lit = sat::mklit(cnf.atom(node.lhs));
+    } else if (node.op == Expression::Constant) {
+        if (truelit == sat::UndefLit) {
+            truelit = sat::mklit(cnf.aux());
+            cnf.add_clause({ truelit });
+        }
+        lit = node.lhs ? truelit : sat::neg(truelit);
+    } else {
+        lit = gates[expr].lit;
+    }
+    return negated ? sat::neg(lit) : lit;
+}
+
+// Skips the negations on top of expr, flipping polarity for each of them
+ExprId TseitinEncoder::strip(ExprId expr, unsigned &polarity, bool &negated) const
+{
+    while (store[expr].op == Expression::Neg) {
+        expr     = store[expr].lhs;
+        polarity = flip(polarity);
+        negated  = !negated;
+    }
+    return expr;
+}
+
+// x ↔ (l1 ∧ ... ∧ ln) resp. x ↔ (l1 ∨ ... ∨ ln), restricted to the requested directions
+void TseitinEncoder::gate(sat::Lit x, const std::vector<sat::Lit> &lits, bool conjunction, unsigned polarity)
+{
+    const auto y = conjunction ? x : sat::neg(x);
+    if (polarity & (conjunction ? Positive : Negative)) {
+        for (const auto l : lits) {
+            cnf.add_clause({ sat::neg(y), conjunction ? l : sat::neg(l) });
+        }
+    }
+    if (polarity & (conjunction ? Negative : Positive)) {
+        std::vector<sat::Lit> clause{ y };
+        for (const auto l : lits) {
+            clause.push_back(conjunction ? sat::neg(l) : l);
+        }
+        cnf.add_clause(clause);
+    }
+}
+
+// Operands of a chain of the same binary operator share one gate
+void TseitinEncoder::flatten(ExprId expr, Expression::Type op, std::vector<ExprId> &out)
+{
+    pending.assign(1, expr);
+    while (!pending.empty()) {
+        const auto e = pending.back();
+        pending.pop_back();
+        const auto &node = store[e];
+        if (node.op == op) {
+            pending.push_back(node.rhs);
+            pending.push_back(node.lhs);
+        } else {
+            out.push_back(e);
+        }
+    }
+}
+
+Cnf tseitin_clauses(const ExpressionStore &store, ExprId expr, bool polarity_aware)
+{
+    return tseitin_clauses(store, expr, store.atoms(expr), polarity_aware);
+}
+
+Cnf tseitin_clauses(const ExpressionStore &store, ExprId expr, const std::vector<AtomId> &inputs, bool polarity_aware)
+{
+    ProfileScope scope("tseitin");
+    Cnf          cnf;
+    for (auto &&a : inputs) {
+        cnf.atom(a);
+    }
+    cnf.inputs = cnf.atoms.size();
+
+    TseitinEncoder encoder(store, cnf, polarity_aware);
+    encoder.assert_true(expr);
+    scope.counter("clauses", cnf.size());
+    scope.counter("auxiliary", cnf.atoms.size() - cnf.inputs);
+    return cnf;
+}
+
+void print_cnf(const Cnf &cnf, FILE *out)
+{
+    if (cnf.size() == 0) {
+        fprintf(out, "tt");
+    }
+    for (std::size_t c = 0; c < cnf.size(); c++) {
+        const auto clause = cnf[c];
+        fprintf(out, "%s(", c ? " ∧ " : "");
+        if (clause.empty()) {
+            fprintf(out, "ff");
+        }
+        for (std::size_t i = 0; i < clause.size(); i++) {
+            fprintf(out, "%s%s%s", i ? " ∨ " : "", sat::sign(clause[i]) ? "¬" : "", cnf.atoms[sat::var(clause[i])].c_str());
+        }
+        fprintf(out, ")");
+    }
+}
+
+void add_clauses(sat::Solver &solver, const Cnf &cnf)
+{
+    for (std::size_t i = 0; i < cnf.atoms.size(); i++) {
+        solver.new_var();
+    }
+    for (std::size_t c = 0; c < cnf.size(); c++) {
+        const auto clause = cnf[c];
+        solver.add_clause({ clause.begin(), clause.end() });
+    }
+}
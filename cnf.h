@@ -0,0 +1,125 @@
+#pragma once
+#include "solver.h"
+
+#include "ast.h"
+
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Literals of one clause inside a Cnf, valid until the next clause is added
+struct Clause {
+    const sat::Lit *first;
+    const sat::Lit *last;
+
+    const sat::Lit *begin() const { return first; }
+    const sat::Lit *end() const { return last; }
+    std::size_t     size() const { return last - first; }
+    bool            empty() const { return first == last; }
+    sat::Lit        operator[](std::size_t i) const { return first[i]; }
+};
+
+// Clause form of a formula, variable i of the clauses stands for atoms[i]. The first
+// inputs variables are atoms of the formula, the rest are auxiliary variables of an encoding.
+// The clauses are stored back to back in one literal array.
+struct Cnf {
+    std::vector<std::string> atoms;
+    std::vector<sat::Lit>    literals;
+    std::vector<std::size_t> ends; // clause c ends before literals[ends[c]]
+    std::size_t              inputs = 0;
+
+    std::size_t size() const { return ends.size(); }
+    Clause      operator[](std::size_t c) const
+    {
+        return { literals.data() + (c ? ends[c - 1] : 0), literals.data() + ends[c] };
+    }
+
+    template<typename It>
+    void add_clause(It first, It last)
+    {
+        literals.insert(literals.end(), first, last);
+        ends.push_back(literals.size());
+    }
+    void add_clause(std::initializer_list<sat::Lit> lits) { add_clause(lits.begin(), lits.end()); }
+    void add_clause(const std::vector<sat::Lit> &lits) { add_clause(lits.begin(), lits.end()); }
+
+    sat::Var atom(AtomId a)
+    {
+        const auto [it, inserted] = index.try_emplace(a, static_cast<sat::Var>(atoms.size()));
+        if (inserted) {
+            atoms.push_back(SymbolTable::global().name(a));
+        }
+        return it->second;
+    }
+
+    // Auxiliary variables are named _1, _2, ... which the lexer never produces for atoms
+    sat::Var aux()
+    {
+        atoms.push_back("_" + std::to_string(atoms.size() - inputs + 1));
+        return static_cast<sat::Var>(atoms.size() - 1);
+    }
+
+private:
+    std::unordered_map<AtomId, sat::Var> index;
+};
+
+// Tseitin encoding into cnf. One encoder may encode several formulas of the same store,
+// subformulas seen before keep their variable and only get the clauses still missing.
+class TseitinEncoder {
+public:
+    enum Polarity : unsigned { Positive = 1, Negative = 2, Both = 3 };
+
+    TseitinEncoder(const ExpressionStore &store, Cnf &cnf, bool polarity_aware = true);
+
+    // Adds clauses that hold exactly when expr is true
+    void assert_true(ExprId expr);
+
+    // Literal equivalent to expr in the given polarities, adds the defining clauses it needs
+    sat::Lit encode(ExprId expr, unsigned polarity);
+
+private:
+    struct Gate {
+        sat::Lit lit;
+        unsigned emitted;
+    };
+
+    // A subformula to encode in some polarities, only the missing ones once it was reached
+    struct Pending {
+        ExprId   expr;
+        unsigned polarity;
+    };
+
+    sat::Lit literal(ExprId expr);
+    ExprId   strip(ExprId expr, unsigned &polarity, bool &negated) const;
+    void     gate(sat::Lit x, const std::vector<sat::Lit> &lits, bool conjunction, unsigned polarity);
+    void     flatten(ExprId expr, Expression::Type op, std::vector<ExprId> &out);
+
+    const ExpressionStore &store;
+    Cnf &                  cnf;
+    bool                   polarity_aware;
+    sat::Lit               truelit = sat::UndefLit;
+    std::vector<Gate>      gates; // indexed by ExprId, grows with the store
+
+    // Scratch space of encode() and flatten()
+    Traversal<Pending>    traversal;
+    std::vector<ExprId>   operands, pending;
+    std::vector<sat::Lit> lits;
+};
+
+// The clauses of cnf as a conjunction of disjunctions in order, the tree form of a KNF
+ExprId knf_expression(ExpressionStore &store, const Cnf &cnf);
+
+// Equisatisfiable clause form with one auxiliary variable per subformula, linear in the size of
+// the expression. With polarity_aware only the implications each occurrence needs are emitted
+// (Plaisted-Greenbaum), otherwise every auxiliary variable is equivalent to its subformula.
+Cnf tseitin_clauses(const ExpressionStore &store, ExprId expr, bool polarity_aware = true);
+
+// The same over the given input atoms, a superset of those of expr. Keeps the atoms a
+// simplified formula lost.
+Cnf tseitin_clauses(const ExpressionStore &store, ExprId expr, const std::vector<AtomId> &inputs, bool polarity_aware = true);
+
+void print_cnf(const Cnf &cnf, FILE *out = stdout);
+
+// Adds the variables and clauses of cnf to the solver, variable i of the solver is atoms[i]
+void add_clauses(sat::Solver &solver, const Cnf &cnf);
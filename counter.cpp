@@ -0,0 +1,303 @@
+#include "counter.h"
+#include "profile.h"
+
+#include <algorithm>
+
+std::size_t ModelCounter::KeyHash::operator()(const Key &key) const
+{
+    std::size_t h = key.size();
+    for (const auto k : key) {
+        h = (h ^ k) * 0x100000001B3ull;
+    }
+    return h ^ (h >> 29);
+}
+
+ModelCounter::ModelCounter(const Cnf &cnf, const std::vector<sat::Var> &projection)
+    : occurs(cnf.atoms.size())
+    , projected(cnf.atoms.size(), 0)
+    , value(cnf.atoms.size(), -1)
+    , parent(cnf.atoms.size())
+    , stamp(cnf.atoms.size(), 0)
+{
+    for (const auto v : projection) {
+        projected[v] = 1;
+    }
+
+    // Sorted clauses without duplicate literals, tautologies are dropped
+    for (std::size_t c = 0; c < cnf.size(); c++) {
+        std::vector<sat::Lit> lits(cnf[c].begin(), cnf[c].end());
+        std::sort(begin(lits), end(lits));
+        lits.erase(std::unique(begin(lits), end(lits)), end(lits));
+
+        bool tautology = false;
+        for (std::size_t i = 1; i < lits.size(); i++) {
+            tautology |= lits[i] == sat::neg(lits[i - 1]);
+        }
+        if (tautology) {
+            continue;
+        }
+        empty_clause |= lits.empty();
+        for (const auto l : lits) {
+            occurs[sat::var(l)].push_back(static_cast<std::uint32_t>(clauses.size()));
+        }
+        clauses.push_back(std::move(lits));
+    }
+}
+
+Natural ModelCounter::count()
+{
+    if (empty_clause) {
+        return 0;
+    }
+    for (const auto &c : clauses) {
+        if (c.size() == 1 && !assign(c[0])) {
+            undo(0);
+            return 0;
+        }
+    }
+
+    std::vector<sat::Var> vars(value.size());
+    for (sat::Var v = 0; v < vars.size(); v++) {
+        vars[v] = v;
+    }
+    std::vector<std::uint32_t> all(clauses.size());
+    for (std::uint32_t c = 0; c < all.size(); c++) {
+        all[c] = c;
+    }
+
+    auto n = count_residual(vars, all);
+    undo(0);
+    return n;
+}
+
+bool ModelCounter::satisfied(std::uint32_t c) const
+{
+    for (const auto l : clauses[c]) {
+        if (is_true(l)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Assigns l and everything unit propagation implies, false on a conflict. The caller undoes
+// the assignments either way.
+bool ModelCounter::assign(sat::Lit l)
+{
+    if (value[sat::var(l)] >= 0) {
+        return is_true(l);
+    }
+
+    auto head          = trail.size();
+    value[sat::var(l)] = static_cast<std::int8_t>(!sat::sign(l));
+    trail.push_back(sat::var(l));
+
+    while (head < trail.size()) {
+        for (const auto c : occurs[trail[head++]]) {
+            sat::Lit    unit = sat::UndefLit;
+            std::size_t free = 0;
+            bool        sat  = false;
+            for (const auto q : clauses[c]) {
+                if (is_true(q)) {
+                    sat = true;
+                    break;
+                }
+                if (value[sat::var(q)] < 0) {
+                    unit = q;
+                    free++;
+                }
+            }
+            if (sat || free > 1) {
+                continue;
+            }
+            if (free == 0) {
+                return false;
+            }
+            value[sat::var(unit)] = static_cast<std::int8_t>(!sat::sign(unit));
+            trail.push_back(sat::var(unit));
+        }
+    }
+    return true;
+}
+
+void ModelCounter::undo(std::size_t mark)
+{
+    for (auto k = mark; k < trail.size(); k++) {
+        value[trail[k]] = -1;
+    }
+    trail.resize(mark);
+}
+
+// Product of the counts of the independent components left of vars and clauses under the
+// current assignment, free projected variables count twice
+Natural ModelCounter::count_residual(const std::vector<sat::Var> &vars, const std::vector<std::uint32_t> &cs)
+{
+    const auto find = [this](sat::Var v) {
+        while (parent[v] != v) {
+            v = parent[v] = parent[parent[v]];
+        }
+        return v;
+    };
+
+    // stamp: epoch for unassigned vars, epoch + 1 once they occur in an open clause
+    epoch += 2;
+    for (const auto v : vars) {
+        if (value[v] < 0) {
+            parent[v] = v;
+            stamp[v]  = epoch;
+        }
+    }
+
+    std::vector<std::uint32_t> open;
+    for (const auto c : cs) {
+        if (satisfied(c)) {
+            continue;
+        }
+        open.push_back(c);
+        sat::Var first = UINT32_MAX;
+        for (const auto l : clauses[c]) {
+            const auto v = sat::var(l);
+            if (value[v] >= 0) {
+                continue;
+            }
+            stamp[v] = epoch + 1;
+            if (first == UINT32_MAX) {
+                first = v;
+            } else {
+                parent[find(v)] = find(first);
+            }
+        }
+    }
+
+    std::size_t                               doubled = 0;
+    std::vector<std::vector<sat::Var>>        compvars;
+    std::vector<std::vector<std::uint32_t>>   compclauses;
+    std::unordered_map<sat::Var, std::size_t> index;
+    for (const auto v : vars) {
+        if (value[v] >= 0) {
+            continue;
+        }
+        if (stamp[v] == epoch) {
+            doubled += projected[v];
+            continue;
+        }
+        const auto [it, inserted] = index.try_emplace(find(v), compvars.size());
+        if (inserted) {
+            compvars.emplace_back();
+            compclauses.emplace_back();
+        }
+        compvars[it->second].push_back(v);
+    }
+    for (const auto c : open) {
+        for (const auto l : clauses[c]) {
+            if (value[sat::var(l)] < 0) {
+                compclauses[index[find(sat::var(l))]].push_back(c);
+                break;
+            }
+        }
+    }
+
+    Natural n = 1;
+    for (std::size_t k = 0; k < compvars.size(); k++) {
+        const auto m = count_component(compvars[k], compclauses[k]);
+        if (m.zero()) {
+            return 0;
+        }
+        n = n * m;
+    }
+    n <<= doubled;
+    return n;
+}
+
+Natural ModelCounter::count_component(const std::vector<sat::Var> &vars, const std::vector<std::uint32_t> &cs)
+{
+    st.components++;
+
+    Key key(vars.begin(), vars.end());
+    key.push_back(UINT32_MAX);
+    key.insert(key.end(), cs.begin(), cs.end());
+    if (const auto it = cache.find(key); it != end(cache)) {
+        st.cache_hits++;
+        return it->second;
+    }
+
+    // Branch on the projected variable with the most open occurrences, without projected
+    // variables only satisfiability is left to decide
+    const bool  exists = std::none_of(begin(vars), end(vars), [this](sat::Var v) { return projected[v]; });
+    sat::Var    best   = vars.front();
+    std::size_t top    = 0;
+    for (const auto v : vars) {
+        if (!exists && !projected[v]) {
+            continue;
+        }
+        std::size_t score = 1;
+        for (const auto c : occurs[v]) {
+            score += !satisfied(c);
+        }
+        if (score > top) {
+            best = v;
+            top  = score;
+        }
+    }
+
+    Natural    n;
+    const auto mark = trail.size();
+    for (const bool negated : { false, true }) {
+        st.decisions++;
+        if (assign(sat::mklit(best, negated))) {
+            auto m = count_residual(vars, cs);
+            if (exists && !m.zero()) {
+                undo(mark);
+                n = 1;
+                break;
+            }
+            n += m;
+        }
+        undo(mark);
+    }
+
+    if (cache.size() > (1u << 22)) {
+        cache.clear();
+    }
+    cache.emplace(std::move(key), n);
+    return n;
+}
+
+Natural count_models(const ExpressionStore &store, ExprId expr, const std::vector<AtomId> *projection, ModelCounter::Stats *stats)
+{
+    // Without the polarity optimization every auxiliary variable is defined by the atoms, a
+    // satisfying assignment of the atoms extends to exactly one model of the clauses
+    const auto  cnf   = tseitin_clauses(store, expr, false);
+    const auto &atoms = store.atoms(expr);
+
+    std::vector<sat::Var> vars;
+    std::size_t           outside = 0;
+    if (projection) {
+        auto wanted = *projection;
+        std::sort(begin(wanted), end(wanted));
+        wanted.erase(std::unique(begin(wanted), end(wanted)), end(wanted));
+        for (const auto a : wanted) {
+            const auto it = std::find(begin(atoms), end(atoms), a);
+            if (it == end(atoms)) {
+                outside++;
+            } else {
+                vars.push_back(static_cast<sat::Var>(it - begin(atoms)));
+            }
+        }
+    } else {
+        for (sat::Var v = 0; v < cnf.inputs; v++) {
+            vars.push_back(v);
+        }
+    }
+
+    ProfileScope scope("count");
+    ModelCounter counter(cnf, vars);
+    auto         n = counter.count();
+    n <<= outside;
+    scope.counter("decisions", counter.stats().decisions);
+    scope.counter("cache_hits", counter.stats().cache_hits);
+    if (stats) {
+        *stats = counter.stats();
+    }
+    return n;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "cnf.h"
+#include "natural.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Exact model counter over a clause set: DPLL search with unit propagation that splits the
+// residual clauses into independent components, counts them separately and caches each
+// component's count. Only the projected variables are counted, the others are existentially
+// quantified, a component without projected variables counts 1 if satisfiable and 0 if not.
+class ModelCounter {
+public:
+    struct Stats {
+        std::uint64_t decisions  = 0;
+        std::uint64_t components = 0;
+        std::uint64_t cache_hits = 0;
+    };
+
+    ModelCounter(const Cnf &cnf, const std::vector<sat::Var> &projection);
+
+    Natural count();
+
+    const Stats &stats() const { return st; }
+
+private:
+    using Key = std::vector<std::uint32_t>;
+
+    struct KeyHash {
+        std::size_t operator()(const Key &key) const;
+    };
+
+    bool    assign(sat::Lit l);
+    void    undo(std::size_t mark);
+    Natural count_residual(const std::vector<sat::Var> &vars, const std::vector<std::uint32_t> &clauses);
+    Natural count_component(const std::vector<sat::Var> &vars, const std::vector<std::uint32_t> &clauses);
+
+    bool satisfied(std::uint32_t c) const;
+    bool is_true(sat::Lit l) const { return value[sat::var(l)] == static_cast<std::int8_t>(!sat::sign(l)); }
+
+    std::vector<std::vector<sat::Lit>>      clauses;
+    std::vector<std::vector<std::uint32_t>> occurs; // clauses of each variable
+    std::vector<std::uint8_t>               projected;
+    std::vector<std::int8_t>                value; // -1 unassigned, 0 false, 1 true
+    std::vector<sat::Var>                   trail;
+    bool                                    empty_clause = false;
+
+    std::unordered_map<Key, Natural, KeyHash> cache;
+    Stats                                     st;
+
+    // Scratch for the component split, indexed by variable
+    std::vector<std::uint32_t> parent, stamp;
+    std::uint32_t              epoch = 0;
+};
+
+// Number of assignments to the atoms of expr that satisfy it, or with a projection the number
+// of assignments to the projected atoms that extend to a satisfying assignment. Projected atoms
+// outside of expr double the count.
+Natural count_models(const ExpressionStore &store, ExprId expr, const std::vector<AtomId> *projection = nullptr,
+                     ModelCounter::Stats *stats = nullptr);
@@ -0,0 +1,268 @@
+#include "dimacs.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+namespace {
+
+// The bytes of an input file, a read only mapping for regular files and a heap copy otherwise
+class Input {
+public:
+    explicit Input(const char *path)
+    {
+        if (std::strcmp(path, "-") == 0) {
+            slurp(stdin);
+            return;
+        }
+
+        const int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, st.st_size, MADV_SEQUENTIAL);
+                mapping = p;
+                first   = static_cast<const char *>(p);
+                last    = first + st.st_size;
+                good    = true;
+            }
+        }
+        if (!good) {
+            if (FILE *f = fdopen(fd, "r")) {
+                slurp(f);
+                fclose(f);
+                return;
+            }
+        }
+        close(fd);
+    }
+
+    ~Input()
+    {
+        if (mapping) {
+            munmap(mapping, last - first);
+        }
+    }
+
+    Input(const Input &) = delete;
+    Input &operator=(const Input &) = delete;
+
+    bool        ok() const { return good; }
+    const char *begin() const { return first; }
+    const char *end() const { return last; }
+
+private:
+    void slurp(FILE *f)
+    {
+        char        chunk[1 << 16];
+        std::size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+            copy.append(chunk, n);
+        }
+        first = copy.data();
+        last  = first + copy.size();
+        good  = !ferror(f);
+    }
+
+    bool        good    = false;
+    void *      mapping = nullptr;
+    const char *first   = nullptr;
+    const char *last    = nullptr;
+    std::string copy;
+};
+
+// Output buffer that only calls fwrite once it is full
+class Writer {
+public:
+    explicit Writer(FILE *out)
+        : out(out)
+    {
+    }
+    ~Writer() { flush(); }
+
+    void put(char c)
+    {
+        if (used == sizeof(buffer)) {
+            flush();
+        }
+        buffer[used++] = c;
+    }
+
+    void put(const std::string &s)
+    {
+        for (const char c : s) {
+            put(c);
+        }
+    }
+
+    void put(long long value)
+    {
+        char digits[24];
+        int  n = 0;
+        if (value < 0) {
+            put('-');
+            value = -value;
+        }
+        do {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value);
+        while (n) {
+            put(digits[--n]);
+        }
+    }
+
+    void flush()
+    {
+        fwrite(buffer, 1, used, out);
+        used = 0;
+    }
+
+private:
+    FILE *      out;
+    char        buffer[1 << 16];
+    std::size_t used = 0;
+};
+
+bool space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+std::string variable_name(std::size_t v) { return "x" + std::to_string(v + 1); }
+}
+
+bool read_dimacs(const char *path, Cnf &cnf)
+{
+    const Input input(path);
+    if (!input.ok()) {
+        fprintf(stderr, "%s: cannot read file\n", path);
+        return false;
+    }
+
+    const char *p    = input.begin();
+    const char *end  = input.end();
+    std::size_t line = 1;
+    bool        header = false;
+
+    const auto fail = [&](const char *what) {
+        fprintf(stderr, "%s:%zu: %s\n", path, line, what);
+        return false;
+    };
+    const auto skip_line = [&] {
+        while (p != end && *p != '\n') {
+            p++;
+        }
+    };
+    const auto skip_space = [&] {
+        for (; p != end && space(*p); p++) {
+            line += *p == '\n';
+        }
+    };
+    const auto number = [&](long long &value) {
+        skip_space();
+        const bool negative = p != end && *p == '-';
+        if (negative) {
+            p++;
+        }
+        if (p == end || *p < '0' || *p > '9') {
+            return false;
+        }
+        value = 0;
+        for (; p != end && *p >= '0' && *p <= '9'; p++) {
+            value = value * 10 + (*p - '0');
+            if (value > INT32_MAX) {
+                return false;
+            }
+        }
+        if (negative) {
+            value = -value;
+        }
+        return p == end || space(*p);
+    };
+
+    while (true) {
+        skip_space();
+        if (p == end || *p == '%') {
+            break;
+        }
+
+        if (*p == 'c') {
+            skip_line();
+        } else if (*p == 'p') {
+            long long vars, clauses;
+            p++;
+            skip_space();
+            if (header || end - p < 3 || std::strncmp(p, "cnf", 3) != 0) {
+                return fail("expected a single \"p cnf <variables> <clauses>\" header");
+            }
+            p += 3;
+            if (!number(vars) || !number(clauses) || vars < 0 || clauses < 0) {
+                return fail("malformed problem line");
+            }
+            header = true;
+            cnf.literals.reserve(3 * clauses);
+            cnf.ends.reserve(clauses);
+            cnf.atoms.reserve(vars);
+            for (auto v = cnf.atoms.size(); v < static_cast<std::size_t>(vars); v++) {
+                cnf.atoms.push_back(variable_name(v));
+            }
+        } else {
+            long long lit;
+            if (!number(lit)) {
+                return fail("expected a literal");
+            }
+            if (lit == 0) {
+                cnf.ends.push_back(cnf.literals.size());
+                continue;
+            }
+            const auto v = static_cast<std::size_t>(lit < 0 ? -lit : lit) - 1;
+            for (auto n = cnf.atoms.size(); n <= v; n++) {
+                cnf.atoms.push_back(variable_name(n));
+            }
+            cnf.literals.push_back(sat::mklit(static_cast<sat::Var>(v), lit < 0));
+        }
+    }
+
+    // Tolerate a missing 0 after the last clause
+    if (cnf.literals.size() != (cnf.ends.empty() ? 0 : cnf.ends.back())) {
+        cnf.ends.push_back(cnf.literals.size());
+    }
+    cnf.inputs = cnf.atoms.size();
+    return true;
+}
+
+void write_dimacs(const Cnf &cnf, FILE *out)
+{
+    Writer w(out);
+    for (std::size_t v = 0; v < cnf.inputs; v++) {
+        if (cnf.atoms[v] != variable_name(v)) {
+            w.put("c ");
+            w.put(static_cast<long long>(v + 1));
+            w.put(' ');
+            w.put(cnf.atoms[v]);
+            w.put('\n');
+        }
+    }
+
+    w.put("p cnf ");
+    w.put(static_cast<long long>(cnf.atoms.size()));
+    w.put(' ');
+    w.put(static_cast<long long>(cnf.size()));
+    w.put('\n');
+
+    for (std::size_t c = 0; c < cnf.size(); c++) {
+        for (const auto l : cnf[c]) {
+            const auto v = static_cast<long long>(sat::var(l)) + 1;
+            w.put(sat::sign(l) ? -v : v);
+            w.put(' ');
+        }
+        w.put('0');
+        w.put('\n');
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include "cnf.h"
+
+#include <cstdio>
+
+// Reads a DIMACS CNF file straight into clauses, variable n of the file becomes atom "xn".
+// Regular files are mapped into memory, "-" reads standard input. Prints a message to
+// stderr and returns false if the file cannot be read or is malformed.
+bool read_dimacs(const char *path, Cnf &cnf);
+
+// Writes cnf in DIMACS format, the names of the input variables go into "c" comment lines
+void write_dimacs(const Cnf &cnf, FILE *out);
@@ -0,0 +1,44 @@
+#include "incremental.h"
+
+#include <algorithm>
+
+IncrementalSolver::IncrementalSolver(const ExpressionStore &store)
+    : store(store)
+    , encoder(store, cnf)
+{
+}
+
+sat::Result IncrementalSolver::solve(ExprId expr, const EvaluationContext &ec)
+{
+    // Only the direction root → expr is needed, the root is assumed and never negated
+    std::vector<sat::Lit> assumptions{ encoder.encode(expr, TseitinEncoder::Positive) };
+    std::vector<AtomId>   atoms{ 0 }; // atoms[i] is assumed by assumptions[i], i > 0
+    for (AtomId a = 0; a < ec.predicates.size(); a++) {
+        if (ec.assigned(a)) {
+            assumptions.push_back(sat::mklit(cnf.atom(a), !ec.get(a)));
+            atoms.push_back(a);
+        }
+    }
+
+    while (solver.num_vars() < cnf.atoms.size()) {
+        solver.new_var();
+    }
+    for (; loaded < cnf.size(); loaded++) {
+        const auto clause = cnf[loaded];
+        solver.add_clause({ clause.begin(), clause.end() });
+    }
+
+    const auto result = solver.solve(assumptions);
+
+    core.clear();
+    if (result == sat::Result::Unsat) {
+        for (const auto l : solver.failed()) {
+            const auto i = std::find(begin(assumptions) + 1, end(assumptions), l) - begin(assumptions);
+            if (i < static_cast<std::ptrdiff_t>(assumptions.size())) {
+                core.emplace_back(atoms[i], !sat::sign(l));
+            }
+        }
+        std::sort(begin(core), end(core));
+    }
+    return result;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "ast.h"
+#include "cnf.h"
+#include "solver.h"
+
+#include <utility>
+#include <vector>
+
+// One solver kept across the statements of a script (--incremental). Every formula asked
+// about is Tseitin encoded into it once, subformulas shared between formulas are encoded
+// once as well. A query assumes the formula and the atoms of all set statements so far,
+// learnt clauses stay for the following queries.
+class IncrementalSolver {
+public:
+    explicit IncrementalSolver(const ExpressionStore &store);
+
+    sat::Result solve(ExprId expr, const EvaluationContext &ec);
+
+    // After Result::Sat
+    bool value(AtomId atom) { return solver.model_value(cnf.atom(atom)); }
+
+    // After Result::Unsat: the set atoms that contradict the formula, with their values.
+    // Empty if the formula is unsatisfiable whatever the set atoms are.
+    const std::vector<std::pair<AtomId, bool>> &failed() const { return core; }
+
+    std::size_t        clauses() const { return cnf.size(); }
+    const sat::Stats & stats() const { return solver.stats(); }
+
+private:
+    const ExpressionStore &              store;
+    Cnf                                  cnf;
+    TseitinEncoder                       encoder;
+    sat::Solver                          solver;
+    std::size_t                          loaded = 0; // clauses of cnf already in the solver
+    std::vector<std::pair<AtomId, bool>> core;
+};
@@ -0,0 +1,305 @@
+#include "localsearch.h"
+#include "cnf.h"
+#include "profile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+namespace {
+
+// Clauses and occurrence lists of a Cnf, both back to back in one array and shared by all
+// walkers. Repeated literals and tautologies are dropped, so a flip changes the number of
+// true literals of a clause by exactly one.
+struct Formula {
+    explicit Formula(const Cnf &cnf);
+
+    std::size_t clauses() const { return starts.size() - 1; }
+
+    std::size_t                vars;
+    std::vector<sat::Lit>      lits;
+    std::vector<std::uint32_t> starts{ 0 }; // clause c is lits[starts[c]] up to lits[starts[c + 1]]
+    std::vector<std::uint32_t> occurs; // clauses of literal l are occurs[first[l]] up to occurs[first[l + 1]]
+    std::vector<std::uint32_t> first;
+    std::size_t                longest = 0;
+    bool                       empty   = false; // an empty clause, no walk can satisfy it
+};
+
+Formula::Formula(const Cnf &cnf)
+    : vars(cnf.atoms.size())
+{
+    std::vector<sat::Lit> clause;
+    for (std::size_t c = 0; c < cnf.size(); c++) {
+        clause.assign(cnf[c].begin(), cnf[c].end());
+        std::sort(begin(clause), end(clause));
+        clause.erase(std::unique(begin(clause), end(clause)), end(clause));
+        bool tautology = false;
+        for (std::size_t i = 1; i < clause.size(); i++) {
+            tautology |= clause[i] == sat::neg(clause[i - 1]);
+        }
+        if (tautology) {
+            continue;
+        }
+        empty |= clause.empty();
+        longest = std::max(longest, clause.size());
+        lits.insert(end(lits), begin(clause), end(clause));
+        starts.push_back(static_cast<std::uint32_t>(lits.size()));
+    }
+
+    first.assign(2 * vars + 1, 0);
+    for (const auto l : lits) {
+        first[l + 1]++;
+    }
+    std::partial_sum(begin(first), end(first), begin(first));
+    occurs.resize(lits.size());
+    auto next = first;
+    for (std::uint32_t c = 0; c < clauses(); c++) {
+        for (auto i = starts[c]; i < starts[c + 1]; i++) {
+            occurs[next[lits[i]]++] = c;
+        }
+    }
+}
+
+// One walk over a Formula. Every clause knows how many of its literals are true and the xor
+// of their variables, which is the variable of the only true literal when there is one. With
+// that a flip updates the break and make counts of the variables and the list of falsified
+// clauses by looking only at the clauses of the two literals of the flipped variable, plus
+// the literals of clauses that become falsified or satisfied.
+class Walker {
+public:
+    Walker(const Formula &formula, const WalkOptions &options, std::uint64_t seed);
+
+    // Flips until no clause is falsified, false if the budget ran out or stop was set first
+    bool run(const std::atomic<bool> &stop);
+
+    bool          value(sat::Var v) const { return values[v]; }
+    std::uint64_t flips() const { return flipped; }
+
+private:
+    struct State {
+        std::uint32_t count; // true literals
+        std::uint32_t vars; // xor of their variables
+    };
+
+    // xorshift64 like the solver, uniform() in [0, 1)
+    std::uint64_t random();
+    double        uniform() { return (random() >> 11) * 0x1.0p-53; }
+
+    bool is_true(sat::Lit l) const { return values[sat::var(l)] != sat::sign(l); }
+
+    void     falsify(std::uint32_t c);
+    void     satisfy(std::uint32_t c);
+    void     flip(sat::Var v);
+    sat::Var probsat(std::uint32_t c);
+    sat::Var walksat(std::uint32_t c);
+
+    const Formula &            formula;
+    const WalkOptions &        options;
+    std::uint64_t              rng;
+    std::vector<std::uint8_t>  values;
+    std::vector<State>         states;
+    std::vector<std::uint32_t> breaks; // per variable, clauses a flip falsifies
+    std::vector<std::uint32_t> makes; // per variable, falsified clauses a flip satisfies
+    std::vector<std::uint32_t> falsified;
+    std::vector<std::uint32_t> where; // position of a falsified clause in falsified
+    std::vector<double>        weights; // probSAT weight by break count, the last one for all higher counts
+    std::vector<double>        scratch; // weights of the variables of one clause
+    std::uint64_t              flipped = 0;
+};
+
+Walker::Walker(const Formula &formula, const WalkOptions &options, std::uint64_t seed)
+    : formula(formula)
+    , options(options)
+    , rng(seed * 0x9E3779B97F4A7C15ull + 1)
+    , values(formula.vars)
+    , states(formula.clauses())
+    , breaks(formula.vars, 0)
+    , makes(formula.vars, 0)
+    , where(formula.clauses())
+    , scratch(formula.longest)
+{
+    for (auto &v : values) {
+        v = random() & 1;
+    }
+    for (std::uint32_t c = 0; c < formula.clauses(); c++) {
+        auto &s = states[c];
+        s       = { 0, 0 };
+        for (auto i = formula.starts[c]; i < formula.starts[c + 1]; i++) {
+            if (is_true(formula.lits[i])) {
+                s.count++;
+                s.vars ^= sat::var(formula.lits[i]);
+            }
+        }
+        if (s.count == 0) {
+            falsify(c);
+        } else if (s.count == 1) {
+            breaks[s.vars]++;
+        }
+    }
+
+    if (options.heuristic == WalkOptions::ProbSat) {
+        weights.resize(64);
+        for (std::size_t b = 0; b < weights.size(); b++) {
+            weights[b] = std::pow(1.0 + b, -options.cb);
+        }
+    }
+}
+
+std::uint64_t Walker::random()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+void Walker::falsify(std::uint32_t c)
+{
+    where[c] = static_cast<std::uint32_t>(falsified.size());
+    falsified.push_back(c);
+    for (auto i = formula.starts[c]; i < formula.starts[c + 1]; i++) {
+        makes[sat::var(formula.lits[i])]++;
+    }
+}
+
+void Walker::satisfy(std::uint32_t c)
+{
+    const auto last     = falsified.back();
+    falsified[where[c]] = last;
+    where[last]         = where[c];
+    falsified.pop_back();
+    for (auto i = formula.starts[c]; i < formula.starts[c + 1]; i++) {
+        makes[sat::var(formula.lits[i])]--;
+    }
+}
+
+void Walker::flip(sat::Var v)
+{
+    values[v] ^= 1;
+    const auto now_true = sat::mklit(v, !values[v]);
+
+    for (auto i = formula.first[now_true]; i < formula.first[now_true + 1]; i++) {
+        const auto c = formula.occurs[i];
+        auto &     s = states[c];
+        if (s.count == 0) {
+            satisfy(c);
+            breaks[v]++;
+        } else if (s.count == 1) {
+            breaks[s.vars]--; // no longer the only one
+        }
+        s.count++;
+        s.vars ^= v;
+    }
+
+    const auto now_false = sat::neg(now_true);
+    for (auto i = formula.first[now_false]; i < formula.first[now_false + 1]; i++) {
+        const auto c = formula.occurs[i];
+        auto &     s = states[c];
+        s.count--;
+        s.vars ^= v;
+        if (s.count == 0) {
+            falsify(c);
+            breaks[v]--;
+        } else if (s.count == 1) {
+            breaks[s.vars]++;
+        }
+    }
+}
+
+sat::Var Walker::probsat(std::uint32_t c)
+{
+    const auto first = formula.starts[c];
+    const auto last  = formula.starts[c + 1];
+    double     sum   = 0;
+    for (auto i = first; i < last; i++) {
+        const auto b = std::min<std::size_t>(breaks[sat::var(formula.lits[i])], weights.size() - 1);
+        sum += scratch[i - first] = weights[b];
+    }
+    auto r = uniform() * sum;
+    for (auto i = first; i + 1 < last; i++) {
+        if ((r -= scratch[i - first]) < 0) {
+            return sat::var(formula.lits[i]);
+        }
+    }
+    return sat::var(formula.lits[last - 1]);
+}
+
+sat::Var Walker::walksat(std::uint32_t c)
+{
+    const auto first = formula.starts[c];
+    const auto last  = formula.starts[c + 1];
+
+    // Least break, ties go to the variable satisfying most falsified clauses
+    auto best = sat::var(formula.lits[first]);
+    for (auto i = first + 1; i < last; i++) {
+        const auto v = sat::var(formula.lits[i]);
+        if (breaks[v] < breaks[best] || (breaks[v] == breaks[best] && makes[v] > makes[best])) {
+            best = v;
+        }
+    }
+    if (breaks[best] > 0 && uniform() < options.noise) {
+        return sat::var(formula.lits[first + random() % (last - first)]);
+    }
+    return best;
+}
+
+bool Walker::run(const std::atomic<bool> &stop)
+{
+    const auto budget = options.flips ? options.flips : UINT64_MAX;
+    while (!falsified.empty()) {
+        if (flipped == budget || ((flipped & 1023) == 0 && stop.load(std::memory_order_relaxed))) {
+            return false;
+        }
+        const auto c = falsified[random() % falsified.size()];
+        flip(options.heuristic == WalkOptions::ProbSat ? probsat(c) : walksat(c));
+        flipped++;
+    }
+    return true;
+}
+}
+
+WalkResult local_search(const Cnf &cnf, const WalkOptions &options, unsigned walkers)
+{
+    ProfileScope  scope("walk");
+    const Formula formula(cnf);
+    WalkResult    out;
+    if (formula.empty) {
+        return out;
+    }
+
+    std::atomic<bool>          done{ false };
+    std::atomic<int>           first{ -1 };
+    std::atomic<std::uint64_t> flips{ 0 };
+
+    const auto work = [&](unsigned w) {
+        Walker     walker(formula, options, options.seed + w);
+        const bool found = walker.run(done);
+        flips.fetch_add(walker.flips(), std::memory_order_relaxed);
+        int none = -1;
+        if (!found || !first.compare_exchange_strong(none, static_cast<int>(w))) {
+            return;
+        }
+        done.store(true, std::memory_order_relaxed);
+
+        out.found  = true;
+        out.winner = w;
+        out.model.resize(formula.vars);
+        for (std::size_t v = 0; v < formula.vars; v++) {
+            out.model[v] = walker.value(static_cast<sat::Var>(v));
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned w = 1; w < walkers; w++) {
+        threads.emplace_back(work, w);
+    }
+    work(0);
+    for (auto &t : threads) {
+        t.join();
+    }
+    out.flips = flips.load();
+    scope.counter("flips", out.flips);
+    return out;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+struct Cnf;
+
+// Stochastic local search starts from a random assignment and flips one variable of a
+// falsified clause at a time until no clause is left falsified. It finds models of large
+// satisfiable instances that CDCL takes long for, but can never show unsatisfiability.
+//
+// probSAT picks the variable at random, weighted by (1 + break)^-cb where break counts
+// the clauses the flip falsifies. WalkSAT takes a variable that breaks nothing if there is
+// one, otherwise a random one with probability noise and the one breaking least else.
+struct WalkOptions {
+    enum Heuristic { ProbSat, WalkSat };
+
+    Heuristic     heuristic = ProbSat;
+    std::uint64_t seed      = 1; // walker w starts from seed + w
+    std::uint64_t flips     = 10000000; // per walker, 0 = until a model is found
+    double        cb        = 2.38; // probSAT, the value for random 3-SAT
+    double        noise     = 0.567; // WalkSAT
+};
+
+struct WalkResult {
+    bool              found = false;
+    std::vector<bool> model;      // when found
+    unsigned          winner = 0; // walker that found the model
+    std::uint64_t     flips  = 0; // of all walkers
+};
+
+// Runs walkers independent walkers on cnf, one thread each. The first to find a model
+// stops the others.
+WalkResult local_search(const Cnf &cnf, const WalkOptions &options, unsigned walkers = 1);
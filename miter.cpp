@@ -0,0 +1,32 @@
+#include "miter.h"
+#include "cnf.h"
+#include "portfolio.h"
+#include "profile.h"
+
+MiterResult check_equivalence(ExpressionStore &store, ExprId f, ExprId g, unsigned threads, ProofCheck *certificate, bool shared)
+{
+    ProfileScope scope("miter");
+
+    const auto  miter  = store.neg(store.binary(Expression::BiImpl, f, g));
+    const auto &inputs = store.atoms(miter);
+    const auto  cnf    = tseitin_clauses(store, shared ? simplify(store, miter) : miter, inputs);
+    const auto  solved = certificate ? solve_certified(cnf, *certificate) : solve_portfolio(cnf, threads);
+
+    MiterResult result;
+    result.equivalent = solved.result != sat::Result::Sat;
+    result.clauses    = cnf.size();
+    result.conflicts  = solved.stats.conflicts;
+    if (!result.equivalent) {
+        for (std::size_t v = 0; v < inputs.size(); v++) {
+            result.witness.emplace_back(inputs[v], solved.model[v]);
+        }
+    }
+    scope.counter("clauses", result.clauses);
+    scope.counter("conflicts", result.conflicts);
+    return result;
+}
+
+MiterResult check_tautology(ExpressionStore &store, ExprId f, unsigned threads, ProofCheck *certificate)
+{
+    return check_equivalence(store, f, store.constant(true), threads, certificate);
+}
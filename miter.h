@@ -0,0 +1,30 @@
+#pragma once
+#include "ast.h"
+#include "proof.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+struct MiterResult {
+    bool                                 equivalent = true;
+    std::vector<std::pair<AtomId, bool>> witness; // where the two formulas differ, over the atoms of both
+    std::size_t                          clauses   = 0;
+    std::uint64_t                        conflicts = 0;
+};
+
+// Decides f ≡ g with a SAT solver on the miter ¬(f ↔ g). Both formulas share their inputs and
+// the Tseitin encoding is linear in their size, the miter is satisfied exactly by the
+// assignments f and g disagree on. Costs what solving costs instead of 2^n evaluations.
+//
+// With a certificate a single solver proves equivalence and the proof is checked into it,
+// see solve_certified().
+//
+// With shared the miter is simplified as an AIG first, which hashes both sides into one graph
+// so common parts cancel out before solving. Checks of a transform turn it off: the transforms
+// start from the same AIG, a wrong rewrite would end up on both sides and cancel out too.
+MiterResult check_equivalence(ExpressionStore &store, ExprId f, ExprId g, unsigned threads = 1, ProofCheck *certificate = nullptr,
+                              bool shared = true);
+
+// f ≡ tt, the witness falsifies f
+MiterResult check_tautology(ExpressionStore &store, ExprId f, unsigned threads = 1, ProofCheck *certificate = nullptr);
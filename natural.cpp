@@ -0,0 +1,103 @@
+#include "natural.h"
+
+#include <algorithm>
+
+Natural::Natural(std::uint64_t value)
+{
+    for (; value; value >>= 32) {
+        limbs.push_back(static_cast<std::uint32_t>(value));
+    }
+}
+
+void Natural::trim()
+{
+    while (!limbs.empty() && !limbs.back()) {
+        limbs.pop_back();
+    }
+}
+
+Natural &Natural::operator+=(const Natural &other)
+{
+    limbs.resize(std::max(limbs.size(), other.limbs.size()) + 1);
+    std::uint64_t carry = 0;
+    for (std::size_t i = 0; i < limbs.size(); i++) {
+        carry += limbs[i];
+        if (i < other.limbs.size()) {
+            carry += other.limbs[i];
+        }
+        limbs[i] = static_cast<std::uint32_t>(carry);
+        carry >>= 32;
+    }
+    trim();
+    return *this;
+}
+
+Natural &Natural::operator<<=(std::size_t bits)
+{
+    if (zero()) {
+        return *this;
+    }
+    const auto words = bits / 32;
+    const auto shift = bits % 32;
+    limbs.insert(limbs.begin(), words, 0);
+    if (shift) {
+        std::uint32_t carry = 0;
+        for (auto i = words; i < limbs.size(); i++) {
+            const auto next = limbs[i] >> (32 - shift);
+            limbs[i]        = (limbs[i] << shift) | carry;
+            carry           = next;
+        }
+        if (carry) {
+            limbs.push_back(carry);
+        }
+    }
+    return *this;
+}
+
+Natural Natural::operator*(const Natural &other) const
+{
+    Natural out;
+    if (zero() || other.zero()) {
+        return out;
+    }
+    out.limbs.assign(limbs.size() + other.limbs.size(), 0);
+    for (std::size_t i = 0; i < limbs.size(); i++) {
+        std::uint64_t carry = 0;
+        for (std::size_t j = 0; j < other.limbs.size(); j++) {
+            carry += out.limbs[i + j] + static_cast<std::uint64_t>(limbs[i]) * other.limbs[j];
+            out.limbs[i + j] = static_cast<std::uint32_t>(carry);
+            carry >>= 32;
+        }
+        out.limbs[i + other.limbs.size()] = static_cast<std::uint32_t>(carry);
+    }
+    out.trim();
+    return out;
+}
+
+std::string Natural::str() const
+{
+    if (zero()) {
+        return "0";
+    }
+
+    // Repeated division by 10^9, each remainder gives nine decimal digits
+    std::vector<std::uint32_t> rest = limbs;
+    std::string                digits;
+    while (!rest.empty()) {
+        std::uint64_t remainder = 0;
+        for (auto i = rest.size(); i-- > 0;) {
+            const auto cur = (remainder << 32) | rest[i];
+            rest[i]        = static_cast<std::uint32_t>(cur / 1000000000);
+            remainder      = cur % 1000000000;
+        }
+        while (!rest.empty() && !rest.back()) {
+            rest.pop_back();
+        }
+        for (int k = 0; k < 9 && (remainder || !rest.empty()); k++) {
+            digits.push_back(static_cast<char>('0' + remainder % 10));
+            remainder /= 10;
+        }
+    }
+    std::reverse(digits.begin(), digits.end());
+    return digits;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Arbitrary precision non-negative integer, enough arithmetic for model counts
+class Natural {
+public:
+    Natural(std::uint64_t value = 0);
+
+    bool zero() const { return limbs.empty(); }
+
+    Natural &operator+=(const Natural &other);
+    Natural &operator<<=(std::size_t bits);
+    Natural  operator*(const Natural &other) const;
+
+    bool operator==(const Natural &other) const { return limbs == other.limbs; }
+
+    std::string str() const; // decimal
+
+private:
+    void trim();
+
+    std::vector<std::uint32_t> limbs; // least significant first, no leading zero limbs
+};
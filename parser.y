@@ -2,26 +2,49 @@
 #include <cstdio>
 #include <cstdlib>
 #include "ast.h"
-extern StatementList finalstmtlist;
 %}
 
 %require "3.2"
 %language "c++"
 %define api.value.type variant
 %define api.token.constructor
+%parse-param { ParseContext &ctx }
+%lex-param { ParseContext &ctx }
 
 %code requires {
+#include <cstdio>
 #include <string>
 #include "ast.h"
+
+// Value of a PREDICATE token, wrapped so the variant can tell it apart from ExprId
+struct Symbol {
+    AtomId atom;
+};
+
+// Everything one parse works on, several scripts can be parsed at the same time as long as
+// each has its own context and store
+struct ParseContext {
+    ExpressionStore &store;
+    StatementSink &  sink;
+    void *           scanner; // yyscan_t of the reentrant scanner
+    FILE *           errors;
+};
 }
 
 %code provides {
-yy::parser::symbol_type yylex();
+yy::parser::symbol_type yylex(void *scanner);
+// Tells the sink while the scanner waits for input, see StatementSink::scanning
+yy::parser::symbol_type yylex(ParseContext &ctx);
+
+// Parses a script and hands its statements to sink, returns false on a syntax error.
+// Reentrant, the scanner state lives on the stack of the call.
+bool parse_script(FILE *in, ExpressionStore &store, StatementSink &sink, FILE *errors = stderr);
+bool parse_script(const std::string &text, ExpressionStore &store, StatementSink &sink, FILE *errors = stderr);
 }
 
 %token IMPLICATION
 %token BIIMPLICATION
-%token <std::string> PREDICATE
+%token <Symbol> PREDICATE
 %token AND 
 %token OR
 %token NEGATION
@@ -40,57 +63,97 @@ yy::parser::symbol_type yylex();
 %token TABLE
 %token NNF
 %token KNF
+%token CNF
+%token SAT
+%token UNSAT
+%token COUNT
+%token DIMACS
+%token BDD
+%token EQUIV
+%token PATHS
+%token SIMPLIFIED
+%token TAUT
+%token WALK
 
 %token EndOfFile 0
 
-%type <std::shared_ptr<Expression>> expression
+%type <ExprId> expression
 %type <Statement*> setstmt printstmt stmt
-%type <StatementList> stmtlist file
+%type <std::vector<AtomId>> atomlist
 
 %start file
 
 %%
 
-file : stmtlist { finalstmtlist = std::move($1); $$ = std::move($1); }
+file : stmtlist
 
-stmtlist : stmt { $$ = StatementList($1); }
-	 | stmtlist stmt { $$ = std::move($1); $$.add($2); }
+/* Every statement goes to the sink as soon as it is reduced, a streaming sink runs it
+   while the next one is parsed */
+stmtlist : stmt { ctx.sink.push($1); }
+	 | stmtlist stmt { ctx.sink.push($2); }
 
 stmt : setstmt ';'
 	 | printstmt ';'
 	 /* | expression ';' { $$ = static_cast<Statement*>($1);} */
 
-setstmt : SET ':' PREDICATE TRUE { $$ = new Statement($3, std::make_shared<ConstantExpression>(true)); }
-		| SET ':' PREDICATE FALSE { $$ = new Statement($3, std::make_shared<ConstantExpression>(false)); }
-		| SET PREDICATE TRUE { $$ = new Statement($2, std::make_shared<ConstantExpression>(false)); }
-		| SET PREDICATE FALSE { $$ = new Statement($2, std::make_shared<ConstantExpression>(false)); }
-		| SET PREDICATE ':' expression { $$ = new Statement($2, $4); }
-
-printstmt : PRINT ':' expression { $$ = new Statement($3); }
-		  | PRINT expression { $$ = new Statement($2); }
-		  | PRINT ATOMS expression { $$ = new Statement($3, Statement::PrintAtoms); }
-		  | PRINT TABLE expression { $$ = new Statement($3, Statement::PrintTable); }
-		  | PRINT NNF expression { $$ = new Statement($3, Statement::PrintNNF); }
-		  | PRINT KNF expression { $$ = new Statement($3, Statement::PrintKNF); }
-
-expression : PREDICATE {$$ = std::make_shared<PredExpression>($1); }
-		   | TRUE { $$ = std::make_shared<ConstantExpression>(true); }
-		   | FALSE { $$ = std::make_shared<ConstantExpression>(false); }
-		   | expression IMPLICATION expression {$$ = std::make_shared<BinaryExpression>($1, $3, BinaryExpression::Impl);}
-		   | expression BIIMPLICATION expression {$$ = std::make_shared<BinaryExpression>($1, $3, BinaryExpression::BiImpl);}
-		   | expression AND expression {$$ = std::make_shared<BinaryExpression>($1, $3, BinaryExpression::And);}
-		   | expression OR expression {$$ = std::make_shared<BinaryExpression>($1, $3, BinaryExpression::Or);}
-		   | NEGATION expression {$$ = std::make_shared<NegExpression>($2);}
+setstmt : SET ':' PREDICATE TRUE { $$ = new Statement(ctx.store, $3.atom, ctx.store.constant(true)); }
+		| SET ':' PREDICATE FALSE { $$ = new Statement(ctx.store, $3.atom, ctx.store.constant(false)); }
+		| SET PREDICATE TRUE { $$ = new Statement(ctx.store, $2.atom, ctx.store.constant(true)); }
+		| SET PREDICATE FALSE { $$ = new Statement(ctx.store, $2.atom, ctx.store.constant(false)); }
+		| SET PREDICATE ':' expression { $$ = new Statement(ctx.store, $2.atom, $4); }
+
+printstmt : PRINT ':' expression { $$ = new Statement(ctx.store, $3); }
+		  | PRINT expression { $$ = new Statement(ctx.store, $2); }
+		  | PRINT ATOMS expression { $$ = new Statement(ctx.store, $3, Statement::PrintAtoms); }
+		  | PRINT TABLE expression { $$ = new Statement(ctx.store, $3, Statement::PrintTable); }
+		  | PRINT TABLE SAT expression { $$ = new Statement(ctx.store, $4, Statement::PrintTableSat); }
+		  | PRINT TABLE UNSAT expression { $$ = new Statement(ctx.store, $4, Statement::PrintTableUnsat); }
+		  | PRINT TABLE COUNT expression { $$ = new Statement(ctx.store, $4, Statement::PrintTableCount); }
+		  | PRINT NNF expression { $$ = new Statement(ctx.store, $3, Statement::PrintNNF); }
+		  | PRINT KNF expression { $$ = new Statement(ctx.store, $3, Statement::PrintKNF); }
+		  | PRINT CNF expression { $$ = new Statement(ctx.store, $3, Statement::PrintCNF); }
+		  | PRINT SAT expression { $$ = new Statement(ctx.store, $3, Statement::PrintSat); }
+		  | PRINT DIMACS expression { $$ = new Statement(ctx.store, $3, Statement::PrintDimacs); }
+		  | PRINT COUNT expression { $$ = new Statement(ctx.store, $3, std::vector<AtomId>{}); }
+		  | PRINT COUNT atomlist ':' expression { $$ = new Statement(ctx.store, $5, std::move($3)); }
+		  | PRINT BDD expression { $$ = new Statement(ctx.store, $3, Statement::PrintBdd); }
+		  /* Compares BDDs, the form with a semicolon solves the miter of the two formulas */
+		  | PRINT EQUIV expression expression { $$ = new Statement(ctx.store, $3, $4, Statement::PrintEquiv); }
+		  | PRINT EQUIV expression ';' expression { $$ = new Statement(ctx.store, $3, $5, Statement::PrintMiter); }
+		  | PRINT TAUT expression { $$ = new Statement(ctx.store, $3, Statement::PrintTaut); }
+		  | PRINT WALK expression { $$ = new Statement(ctx.store, $3, Statement::PrintWalk); }
+		  | PRINT PATHS expression { $$ = new Statement(ctx.store, $3, Statement::PrintPaths); }
+		  | PRINT SIMPLIFIED expression { $$ = new Statement(ctx.store, $3, Statement::PrintSimplified); }
+
+atomlist : PREDICATE { $$ = { $1.atom }; }
+		 | atomlist ',' PREDICATE { $$ = std::move($1); $$.push_back($3.atom); }
+
+expression : PREDICATE {$$ = ctx.store.pred($1.atom); }
+		   | TRUE { $$ = ctx.store.constant(true); }
+		   | FALSE { $$ = ctx.store.constant(false); }
+		   | expression IMPLICATION expression {$$ = ctx.store.binary(Expression::Impl, $1, $3);}
+		   | expression BIIMPLICATION expression {$$ = ctx.store.binary(Expression::BiImpl, $1, $3);}
+		   | expression AND expression {$$ = ctx.store.binary(Expression::And, $1, $3);}
+		   | expression OR expression {$$ = ctx.store.binary(Expression::Or, $1, $3);}
+		   | NEGATION expression {$$ = ctx.store.neg($2);}
 		   | '(' expression ')' { $$ = $2; }
 %%
 
+yy::parser::symbol_type yylex(ParseContext &ctx)
+{
+	ctx.sink.scanning(true);
+	auto token = yylex(ctx.scanner);
+	ctx.sink.scanning(false);
+	return token;
+}
+
 void yyerror(char *s) {
 printf("Error: %s\n", s);
 }
 
 void yy::parser::error(const std::string& error)
 {
-	std::cerr << error << '\n';
+	fprintf(ctx.errors, "%s\n", error.c_str());
 }
 
 
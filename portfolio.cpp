@@ -0,0 +1,170 @@
+#include "portfolio.h"
+#include "profile.h"
+
+#include <algorithm>
+#include <thread>
+
+ClauseRing::ClauseRing(std::size_t capacity)
+{
+    std::size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    slots = std::make_unique<Slot[]>(size);
+    mask  = size - 1;
+}
+
+void ClauseRing::push(std::uint32_t producer, const std::vector<sat::Lit> &lits)
+{
+    if (lits.size() > MaxLits) {
+        return;
+    }
+
+    // A seqlock per slot. A writer that finds the slot busy, or already holding a newer
+    // clause after the ring wrapped around, drops its clause.
+    const auto pos  = head.fetch_add(1, std::memory_order_relaxed);
+    auto &     slot = slots[pos & mask];
+    auto       seq  = slot.seq.load(std::memory_order_relaxed);
+    if ((seq & 1) || seq > 2 * pos || !slot.seq.compare_exchange_strong(seq, 2 * pos + 1, std::memory_order_relaxed)) {
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.producer.store(producer, std::memory_order_relaxed);
+    slot.size.store(static_cast<std::uint32_t>(lits.size()), std::memory_order_relaxed);
+    for (std::size_t i = 0; i < lits.size(); i++) {
+        slot.lits[i].store(lits[i], std::memory_order_relaxed);
+    }
+    slot.seq.store(2 * pos + 2, std::memory_order_release);
+}
+
+bool ClauseRing::next(std::uint64_t &cursor, std::uint32_t reader, std::vector<sat::Lit> &lits) const
+{
+    const auto end = head.load(std::memory_order_acquire);
+    if (end - cursor > mask + 1) {
+        cursor = end - (mask + 1); // lapped, the older entries are gone
+    }
+
+    for (; cursor < end; cursor++) {
+        const auto &slot = slots[cursor & mask];
+        const auto  seq  = slot.seq.load(std::memory_order_acquire);
+        if (seq != 2 * cursor + 2 || slot.producer.load(std::memory_order_relaxed) == reader) {
+            continue;
+        }
+
+        const auto size = std::min<std::size_t>(slot.size.load(std::memory_order_relaxed), MaxLits);
+        lits.resize(size);
+        for (std::size_t i = 0; i < size; i++) {
+            lits[i] = slot.lits[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == seq) {
+            cursor++;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+class RingSharing : public sat::ClauseSharing {
+public:
+    RingSharing(ClauseRing &ring, const std::atomic<bool> &done, std::uint32_t id)
+        : ring(ring)
+        , done(done)
+        , id(id)
+    {
+    }
+
+    void export_clause(const std::vector<sat::Lit> &lits) override { ring.push(id, lits); }
+    bool import_clause(std::vector<sat::Lit> &lits) override { return ring.next(cursor, id, lits); }
+    bool stopped() const override { return done.load(std::memory_order_relaxed); }
+
+private:
+    ClauseRing &             ring;
+    const std::atomic<bool> &done;
+    std::uint32_t            id;
+    std::uint64_t            cursor = 0;
+};
+
+// Worker 0 runs the default configuration, the others diversify around it
+sat::Options configuration(unsigned worker)
+{
+    sat::Options opts;
+    if (worker == 0) {
+        return opts;
+    }
+
+    opts.seed = worker;
+    switch (worker % 4) {
+    case 1:
+        opts.restarts      = sat::Restarts::Geometric;
+        opts.restart_first = 100;
+        opts.restart_inc   = 1.5;
+        break;
+    case 2:
+        opts.phase_saving  = false;
+        opts.initial_phase = worker % 8 == 6;
+        break;
+    case 3:
+        opts.initial_phase = true;
+        opts.restart_first = 50;
+        break;
+    default:
+        opts.random_freq = 0.02;
+        opts.var_decay   = 0.9;
+        break;
+    }
+    return opts;
+}
+}
+
+PortfolioResult solve_portfolio(const Cnf &cnf, unsigned threads, sat::ProofSink *proof)
+{
+    ProfileScope scope("solve");
+    threads = proof ? 1 : std::max(threads, 1u);
+
+    ClauseRing        ring(threads > 1 ? 1 << 14 : 1);
+    std::atomic<bool> done{ false };
+    std::atomic<int>  first{ -1 };
+    PortfolioResult   out;
+
+    const auto work = [&](unsigned worker) {
+        RingSharing sharing(ring, done, worker);
+        sat::Solver solver(configuration(worker));
+        solver.prove(proof, cnf.size());
+        add_clauses(solver, cnf);
+        if (threads > 1) {
+            solver.share(&sharing, ClauseRing::MaxLits);
+        }
+
+        const auto result = solver.solve();
+        int        none   = -1;
+        if (result == sat::Result::Unknown || !first.compare_exchange_strong(none, static_cast<int>(worker))) {
+            return;
+        }
+        done.store(true, std::memory_order_relaxed);
+
+        out.result = result;
+        out.winner = worker;
+        out.stats  = solver.stats();
+        if (result == sat::Result::Sat) {
+            out.model.resize(cnf.atoms.size());
+            for (std::size_t v = 0; v < cnf.atoms.size(); v++) {
+                out.model[v] = solver.model_value(static_cast<sat::Var>(v));
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned w = 1; w < threads; w++) {
+        workers.emplace_back(work, w);
+    }
+    work(0);
+    for (auto &t : workers) {
+        t.join();
+    }
+    scope.counter("conflicts", out.stats.conflicts);
+    return out;
+}
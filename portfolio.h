@@ -0,0 +1,51 @@
+#pragma once
+#include "cnf.h"
+#include "solver.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Broadcast ring of short clauses for any number of writers and readers, without locks.
+// Every reader walks the ring with its own cursor. Writers never wait: a clause is dropped
+// when its slot is busy, and readers skip entries that were overwritten or are still being
+// written, so sharing is best effort and never blocks a search.
+class ClauseRing {
+public:
+    static constexpr std::size_t MaxLits = 8;
+
+    explicit ClauseRing(std::size_t capacity = 1 << 14);
+
+    void push(std::uint32_t producer, const std::vector<sat::Lit> &lits);
+
+    // Copies the next clause after cursor that another producer than reader wrote into lits
+    bool next(std::uint64_t &cursor, std::uint32_t reader, std::vector<sat::Lit> &lits) const;
+
+private:
+    struct Slot {
+        std::atomic<std::uint64_t> seq{ 0 }; // 2 * position + 2 once written, odd while writing
+        std::atomic<std::uint32_t> producer{ 0 };
+        std::atomic<std::uint32_t> size{ 0 };
+        std::atomic<sat::Lit>      lits[MaxLits];
+    };
+
+    std::unique_ptr<Slot[]>    slots;
+    std::size_t                mask;
+    std::atomic<std::uint64_t> head{ 0 };
+};
+
+struct PortfolioResult {
+    sat::Result       result = sat::Result::Unknown;
+    std::vector<bool> model;      // of the winner, when result is Sat
+    unsigned          winner = 0; // worker that finished first
+    sat::Stats        stats;      // of the winner
+};
+
+// Solves cnf with threads differently configured solvers at once. They vary seeds, restart
+// policies and phase selection and exchange learnt clauses of up to ClauseRing::MaxLits
+// literals. The first solver to finish stops the others.
+//
+// With a proof a single solver runs, clauses imported from other solvers would not be
+// justified by it.
+PortfolioResult solve_portfolio(const Cnf &cnf, unsigned threads, sat::ProofSink *proof = nullptr);
@@ -0,0 +1,402 @@
+#include "preprocess.h"
+#include "profile.h"
+
+#include <algorithm>
+
+static std::uint64_t signature(const std::vector<sat::Lit> &lits)
+{
+    std::uint64_t sig = 0;
+    for (const auto l : lits) {
+        sig |= 1ull << (sat::var(l) % 64);
+    }
+    return sig;
+}
+
+Preprocessor::Preprocessor(const Cnf &cnf)
+    : atoms(cnf.atoms)
+    , inputs(cnf.inputs)
+    , occs(2 * cnf.atoms.size())
+    , value(cnf.atoms.size(), -1)
+    , gone(cnf.atoms.size(), 0)
+    , touched(cnf.atoms.size(), 1)
+    , marks(2 * cnf.atoms.size(), 0)
+{
+    st.before = cnf.size();
+
+    std::vector<sat::Lit> lits;
+    for (std::size_t c = 0; c < cnf.size(); c++) {
+        lits.clear();
+        bool tautology = false;
+        for (const auto l : cnf[c]) {
+            if (marks[l]) {
+                st.duplicates++;
+                continue;
+            }
+            tautology |= marks[sat::neg(l)] != 0;
+            marks[l] = 1;
+            lits.push_back(l);
+        }
+        for (const auto l : lits) {
+            marks[l] = 0;
+        }
+        if (tautology) {
+            st.tautologies++;
+        } else {
+            add(lits);
+        }
+    }
+}
+
+// Units go straight to the propagation queue, everything longer becomes a clause
+void Preprocessor::add(std::vector<sat::Lit> lits)
+{
+    if (lits.empty()) {
+        conflict = true;
+    } else if (lits.size() == 1) {
+        units.push_back(lits[0]);
+    } else {
+        const auto c = static_cast<std::uint32_t>(clauses.size());
+        for (const auto l : lits) {
+            occs[l].push_back(c);
+            touched[sat::var(l)] = 1;
+        }
+        const auto sig = signature(lits);
+        clauses.push_back({ std::move(lits), sig });
+        queue.push_back(c);
+        queued.push_back(1);
+    }
+}
+
+// Occurrence lists are cleaned up lazily by occurrences()
+void Preprocessor::remove(std::uint32_t c)
+{
+    clauses[c].removed = true;
+    for (const auto l : clauses[c].lits) {
+        touched[sat::var(l)] = 1;
+    }
+}
+
+void Preprocessor::strengthen(std::uint32_t c, sat::Lit lit)
+{
+    auto &clause = clauses[c];
+    clause.lits.erase(std::find(begin(clause.lits), end(clause.lits), lit));
+    clause.sig = signature(clause.lits);
+    touched[sat::var(lit)] = 1;
+    if (const auto it = std::find(begin(occs[lit]), end(occs[lit]), c); it != end(occs[lit])) {
+        occs[lit].erase(it);
+    }
+    st.strengthened++;
+
+    if (clause.lits.size() == 1) {
+        units.push_back(clause.lits[0]);
+        remove(c);
+    } else if (!queued[c]) {
+        queued[c] = 1;
+        queue.push_back(c);
+    }
+}
+
+const std::vector<std::uint32_t> &Preprocessor::occurrences(sat::Lit l)
+{
+    auto &list = occs[l];
+    list.erase(std::remove_if(begin(list), end(list), [this](std::uint32_t c) { return clauses[c].removed; }), end(list));
+    return list;
+}
+
+void Preprocessor::propagate()
+{
+    while (!units.empty() && !conflict) {
+        const auto l = units.back();
+        units.pop_back();
+        if (value[sat::var(l)] >= 0) {
+            conflict |= !is_true(l);
+            continue;
+        }
+        value[sat::var(l)] = static_cast<std::int8_t>(!sat::sign(l));
+        trail.push_back(l);
+        st.units++;
+
+        for (const auto c : occs[l]) {
+            if (!clauses[c].removed) {
+                remove(c);
+                st.satisfied++;
+            }
+        }
+        occs[l].clear();
+
+        const auto falsified = std::move(occs[sat::neg(l)]);
+        occs[sat::neg(l)].clear();
+        for (const auto c : falsified) {
+            if (!clauses[c].removed) {
+                strengthen(c, sat::neg(l));
+            }
+        }
+    }
+}
+
+void Preprocessor::subsume()
+{
+    propagate();
+    while (!queue.empty() && !conflict) {
+        const auto c = queue.back();
+        queue.pop_back();
+        queued[c] = 0;
+        if (!clauses[c].removed) {
+            backward(c);
+            propagate();
+        }
+    }
+}
+
+// Removes the clauses c subsumes and strengthens those it resolves with into a subset of
+// themselves. All of them contain some variable of c, the one with the fewest
+// occurrences is searched.
+void Preprocessor::backward(std::uint32_t c)
+{
+    const auto lits = clauses[c].lits;
+    const auto sig  = clauses[c].sig;
+
+    auto pivot = lits[0];
+    for (const auto l : lits) {
+        if (occs[l].size() + occs[sat::neg(l)].size() < occs[pivot].size() + occs[sat::neg(pivot)].size()) {
+            pivot = l;
+        }
+    }
+
+    for (const auto l : lits) {
+        marks[l] = 1;
+    }
+    for (const auto side : { pivot, sat::neg(pivot) }) {
+        const auto candidates = occs[side];
+        for (const auto d : candidates) {
+            const auto &other = clauses[d];
+            if (d == c || other.removed || other.lits.size() < lits.size() || (sig & ~other.sig)) {
+                continue;
+            }
+
+            std::size_t common = 0, flipped = 0;
+            sat::Lit    flip   = sat::UndefLit;
+            for (const auto l : other.lits) {
+                if (marks[l]) {
+                    common++;
+                } else if (marks[sat::neg(l)]) {
+                    flipped++;
+                    flip = l;
+                }
+            }
+            if (common == lits.size()) {
+                remove(d);
+                st.subsumed++;
+            } else if (flipped == 1 && common + 1 == lits.size()) {
+                strengthen(d, flip);
+            }
+        }
+    }
+    for (const auto l : lits) {
+        marks[l] = 0;
+    }
+}
+
+// Whether a clause that is already there subsumes lits
+bool Preprocessor::forward(const std::vector<sat::Lit> &lits)
+{
+    const auto sig      = signature(lits);
+    bool       subsumed = false;
+    for (const auto l : lits) {
+        marks[l] = 1;
+    }
+    for (std::size_t i = 0; i < lits.size() && !subsumed; i++) {
+        for (const auto c : occurrences(lits[i])) {
+            const auto &other = clauses[c];
+            if (other.lits.size() <= lits.size() && !(other.sig & ~sig)
+                && std::all_of(begin(other.lits), end(other.lits), [this](sat::Lit l) { return marks[l] != 0; })) {
+                subsumed = true;
+                break;
+            }
+        }
+    }
+    for (const auto l : lits) {
+        marks[l] = 0;
+    }
+    return subsumed;
+}
+
+void Preprocessor::pure_literals()
+{
+    for (sat::Var v = 0; v < value.size(); v++) {
+        if (value[v] >= 0 || gone[v] || !touched[v]) {
+            continue;
+        }
+        const auto positive = occurrences(sat::mklit(v)).size();
+        const auto negative = occurrences(sat::mklit(v, true)).size();
+        if ((positive == 0) == (negative == 0)) {
+            continue;
+        }
+
+        const auto lit = sat::mklit(v, positive == 0);
+        for (const auto c : occs[lit]) {
+            stack.emplace_back(lit, clauses[c].lits);
+            remove(c);
+        }
+        occs[lit].clear();
+        gone[v] = 1;
+        st.pure++;
+    }
+}
+
+void Preprocessor::eliminate(const Options &options)
+{
+    // Cheapest candidates first, the number of resolvents is at most their product. Variables
+    // whose clauses did not change since they were last tried are skipped.
+    std::vector<std::pair<std::size_t, sat::Var>> candidates;
+    for (sat::Var v = 0; v < value.size(); v++) {
+        if (value[v] < 0 && !gone[v] && touched[v]) {
+            touched[v] = 0;
+            candidates.emplace_back(occurrences(sat::mklit(v)).size() * occurrences(sat::mklit(v, true)).size(), v);
+        }
+    }
+    std::sort(begin(candidates), end(candidates));
+
+    for (const auto &[cost, v] : candidates) {
+        if (conflict) {
+            break;
+        }
+        if (value[v] < 0 && !gone[v] && eliminate(v, options)) {
+            subsume();
+        }
+    }
+}
+
+// Resolvent of the clauses p and n on v into resolvent, false if it is a tautology
+bool Preprocessor::resolve(std::uint32_t p, std::uint32_t n, sat::Var v)
+{
+    resolvent.clear();
+    for (const auto l : clauses[p].lits) {
+        if (sat::var(l) != v) {
+            resolvent.push_back(l);
+            marks[l] = 1;
+        }
+    }
+    bool tautology = false;
+    for (const auto l : clauses[n].lits) {
+        if (sat::var(l) == v || marks[l]) {
+            continue;
+        }
+        if (marks[sat::neg(l)]) {
+            tautology = true;
+            break;
+        }
+        resolvent.push_back(l);
+    }
+    for (const auto l : clauses[p].lits) {
+        marks[l] = 0;
+    }
+    return !tautology;
+}
+
+// Replaces the clauses of v by all their non-tautological resolvents on v, as long as that
+// does not add clauses
+bool Preprocessor::eliminate(sat::Var v, const Options &options)
+{
+    const auto positive = occurrences(sat::mklit(v));
+    const auto negative = occurrences(sat::mklit(v, true));
+    if (positive.size() > options.occurrences || negative.size() > options.occurrences) {
+        return false;
+    }
+
+    // Count first, most candidates fail and should not pay for building their resolvents
+    std::size_t added = 0;
+    for (const auto p : positive) {
+        for (const auto n : negative) {
+            if (resolve(p, n, v) && (++added > positive.size() + negative.size() || resolvent.size() > options.resolvent)) {
+                return false;
+            }
+        }
+    }
+
+    std::vector<std::vector<sat::Lit>> resolvents;
+    for (const auto p : positive) {
+        for (const auto n : negative) {
+            if (resolve(p, n, v)) {
+                resolvents.push_back(resolvent);
+            }
+        }
+    }
+    for (const auto c : positive) {
+        stack.emplace_back(sat::mklit(v), clauses[c].lits);
+        remove(c);
+    }
+    for (const auto c : negative) {
+        stack.emplace_back(sat::mklit(v, true), clauses[c].lits);
+        remove(c);
+    }
+    gone[v] = 1;
+    st.eliminated++;
+
+    for (auto &resolvent : resolvents) {
+        if (!forward(resolvent)) {
+            st.resolvents++;
+            add(std::move(resolvent));
+        }
+    }
+    return true;
+}
+
+Cnf Preprocessor::run(const Options &options)
+{
+    ProfileScope scope("preprocess");
+    subsume();
+
+    // Elimination creates new pure literals and candidates, a few rounds catch most of them
+    for (int round = 0; round < 4 && !conflict; round++) {
+        const auto removed = st.pure + st.eliminated;
+        if (options.pure) {
+            pure_literals();
+        }
+        if (options.eliminate) {
+            eliminate(options);
+        }
+        if (st.pure + st.eliminated == removed) {
+            break;
+        }
+    }
+
+    Cnf out;
+    out.atoms  = atoms;
+    out.inputs = inputs;
+    if (conflict) {
+        out.add_clause({});
+    } else {
+        for (const auto l : trail) {
+            out.add_clause({ l });
+        }
+        for (const auto &clause : clauses) {
+            if (!clause.removed) {
+                out.add_clause(clause.lits);
+            }
+        }
+    }
+    st.after = out.size();
+    scope.counter("clauses_before", st.before);
+    scope.counter("clauses_after", st.after);
+    return out;
+}
+
+void Preprocessor::extend(std::vector<bool> &model) const
+{
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+        const auto &[witness, lits] = *it;
+        if (std::none_of(begin(lits), end(lits), [&](sat::Lit l) { return model[sat::var(l)] != sat::sign(l); })) {
+            model[sat::var(witness)] = !sat::sign(witness);
+        }
+    }
+}
+
+void print_stats(const Preprocessor::Stats &stats, FILE *out)
+{
+    fprintf(out,
+            "%zu → %zu clauses: %zu units satisfying %zu clauses, %zu tautologies, %zu duplicate literals, %zu subsumed, "
+            "%zu strengthened, %zu pure, %zu eliminated with %zu resolvents",
+            stats.before, stats.after, stats.units, stats.satisfied, stats.tautologies, stats.duplicates, stats.subsumed,
+            stats.strengthened, stats.pure, stats.eliminated, stats.resolvents);
+}
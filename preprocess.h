@@ -0,0 +1,94 @@
+#pragma once
+#include "cnf.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+// Simplifies a clause set before it is printed or solved: unit propagation, removal of
+// duplicate literals and tautologies, subsumption and self-subsuming resolution, and
+// optionally pure literal elimination and bounded variable elimination (SatELite).
+//
+// The last two only preserve satisfiability. The clauses they remove are kept on a
+// reconstruction stack together with the literal that satisfies them, extend() walks it
+// backwards to turn a model of the simplified clauses into one of the input.
+class Preprocessor {
+public:
+    struct Options {
+        bool        pure        = true;
+        bool        eliminate   = true;
+        std::size_t occurrences = 16; // eliminated variables occur at most this often per polarity
+        std::size_t resolvent   = 24; // longest resolvent elimination may add
+    };
+
+    struct Stats {
+        std::size_t before       = 0; // clauses
+        std::size_t after        = 0;
+        std::size_t duplicates   = 0; // literals
+        std::size_t tautologies  = 0;
+        std::size_t units        = 0; // variables fixed by unit propagation
+        std::size_t satisfied    = 0; // clauses removed by those
+        std::size_t subsumed     = 0;
+        std::size_t strengthened = 0; // literals removed by self-subsuming resolution or units
+        std::size_t pure         = 0; // variables
+        std::size_t eliminated   = 0; // variables
+        std::size_t resolvents   = 0; // clauses added by elimination
+    };
+
+    explicit Preprocessor(const Cnf &cnf);
+
+    // Simplified clauses over the same variables, fixed variables stay as unit clauses and an
+    // empty clause is all that is left of an unsatisfiable input. Equivalent to the input
+    // without pure literals and elimination.
+    Cnf run(const Options &options);
+
+    void extend(std::vector<bool> &model) const;
+
+    const Stats &stats() const { return st; }
+
+private:
+    struct Entry {
+        std::vector<sat::Lit> lits; // in input order
+        std::uint64_t         sig     = 0; // one bit per variable modulo 64
+        bool                  removed = false;
+    };
+
+    void add(std::vector<sat::Lit> lits);
+    void remove(std::uint32_t c);
+    void strengthen(std::uint32_t c, sat::Lit lit);
+    void propagate();
+    void subsume();
+    void backward(std::uint32_t c);
+    bool forward(const std::vector<sat::Lit> &lits);
+    void pure_literals();
+    void eliminate(const Options &options);
+    bool eliminate(sat::Var v, const Options &options);
+    bool resolve(std::uint32_t p, std::uint32_t n, sat::Var v);
+
+    // Occurrences of l without the removed clauses
+    const std::vector<std::uint32_t> &occurrences(sat::Lit l);
+
+    bool is_true(sat::Lit l) const { return value[sat::var(l)] == static_cast<std::int8_t>(!sat::sign(l)); }
+
+    std::vector<std::string> atoms;
+    std::size_t              inputs;
+
+    std::vector<Entry>                      clauses;
+    std::vector<std::vector<std::uint32_t>> occs; // indexed by literal
+    std::vector<std::int8_t>                value; // -1 unassigned, 0 false, 1 true
+    std::vector<std::uint8_t>               gone; // variables removed as pure or by elimination
+    std::vector<std::uint8_t>               touched; // variables whose clauses changed since elimination tried them
+    std::vector<sat::Lit>                   trail, units;
+    std::vector<std::uint32_t>              queue; // candidates for backward subsumption
+    std::vector<std::uint8_t>               queued;
+    std::vector<std::uint8_t>               marks; // indexed by literal
+    std::vector<sat::Lit>                   resolvent; // scratch of resolve()
+    bool                                    conflict = false;
+
+    std::vector<std::pair<sat::Lit, std::vector<sat::Lit>>> stack; // witness and removed clause
+    Stats                                                   st;
+};
+
+// One line summary of what each step removed
+void print_stats(const Preprocessor::Stats &stats, FILE *out);
@@ -0,0 +1,152 @@
+#include "profile.h"
+
+#include <map>
+#include <string>
+
+// Running events of the calling thread, innermost last
+struct OpenEvents {
+    std::uint32_t              thread = Profiler::NoEvent;
+    std::vector<std::uint32_t> stack;
+};
+static thread_local OpenEvents open;
+
+Profiler &Profiler::global()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::enable()
+{
+    epoch    = std::chrono::steady_clock::now();
+    on       = true;
+    counting = true;
+}
+
+std::uint64_t Profiler::now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+std::uint32_t Profiler::begin(const char *name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (open.thread == NoEvent) {
+        open.thread = threads++;
+    }
+    const auto id = static_cast<std::uint32_t>(events.size());
+    events.push_back({ name, open.stack.empty() ? NoEvent : open.stack.back(), open.thread, 0, 0, 0, {} });
+    open.stack.push_back(id);
+    // Last, so the bookkeeping above is not part of the event
+    events.back().allocations = allocations.load(std::memory_order_relaxed);
+    events.back().start       = now();
+    return id;
+}
+
+void Profiler::end(std::uint32_t id)
+{
+    const auto                  stop = now();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &                      event = events[id];
+    event.duration                    = stop - event.start;
+    event.allocations                 = allocations.load(std::memory_order_relaxed) - event.allocations;
+    // Scopes end in reverse order, except for an event ended while a nested one runs
+    while (!open.stack.empty() && open.stack.back() != id) {
+        open.stack.pop_back();
+    }
+    if (!open.stack.empty()) {
+        open.stack.pop_back();
+    }
+}
+
+void Profiler::counter(std::uint32_t id, const char *name, std::uint64_t value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    events[id].counters.emplace_back(name, value);
+}
+
+static void write_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', out);
+        }
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+void Profiler::write_stats(FILE *out) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::vector<std::uint32_t>> children(events.size() + 1); // last: top level
+    for (std::uint32_t id = 0; id < events.size(); id++) {
+        children[events[id].parent == NoEvent ? events.size() : events[id].parent].push_back(id);
+    }
+
+    const auto write = [&](auto &self, std::uint32_t id, int indent) -> void {
+        const auto &event = events[id];
+        fprintf(out, "%*s{ \"name\": ", indent, "");
+        write_string(out, event.name);
+        fprintf(out, ", \"ms\": %.3f, \"allocations\": %llu", event.duration / 1e6, static_cast<unsigned long long>(event.allocations));
+        for (const auto &[name, value] : event.counters) {
+            fprintf(out, ", ");
+            write_string(out, name);
+            fprintf(out, ": %llu", static_cast<unsigned long long>(value));
+        }
+        if (!children[id].empty()) {
+            fprintf(out, ", \"phases\": [\n");
+            for (std::size_t i = 0; i < children[id].size(); i++) {
+                self(self, children[id][i], indent + 4);
+                fprintf(out, "%s\n", i + 1 < children[id].size() ? "," : "");
+            }
+            fprintf(out, "%*s]", indent, "");
+        }
+        fprintf(out, " }");
+    };
+
+    std::map<std::string, std::pair<std::uint64_t, std::uint64_t>> totals; // calls and ns per name
+    for (const auto &event : events) {
+        auto &total = totals[event.name];
+        total.first++;
+        total.second += event.duration;
+    }
+
+    fprintf(out, "{\n    \"ms\": %.3f,\n    \"allocations\": %llu,\n    \"events\": [\n", now() / 1e6,
+            static_cast<unsigned long long>(allocations.load()));
+    const auto &top = children[events.size()];
+    for (std::size_t i = 0; i < top.size(); i++) {
+        write(write, top[i], 8);
+        fprintf(out, "%s\n", i + 1 < top.size() ? "," : "");
+    }
+    fprintf(out, "    ],\n    \"totals\": {\n");
+    std::size_t i = 0;
+    for (const auto &[name, total] : totals) {
+        fprintf(out, "        ");
+        write_string(out, name.c_str());
+        fprintf(out, ": { \"calls\": %llu, \"ms\": %.3f }%s\n", static_cast<unsigned long long>(total.first), total.second / 1e6,
+                ++i < totals.size() ? "," : "");
+    }
+    fprintf(out, "    }\n}\n");
+}
+
+void Profiler::write_trace(FILE *out) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    fprintf(out, "{ \"traceEvents\": [\n");
+    for (std::size_t i = 0; i < events.size(); i++) {
+        const auto &event = events[i];
+        fprintf(out, "    { \"name\": ");
+        write_string(out, event.name);
+        fprintf(out, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, \"args\": { \"allocations\": %llu",
+                event.thread + 1, event.start / 1e3, event.duration / 1e3, static_cast<unsigned long long>(event.allocations));
+        for (const auto &[name, value] : event.counters) {
+            fprintf(out, ", ");
+            write_string(out, name);
+            fprintf(out, ": %llu", static_cast<unsigned long long>(value));
+        }
+        fprintf(out, " } }%s\n", i + 1 < events.size() ? "," : "");
+    }
+    fprintf(out, "], \"displayTimeUnit\": \"ms\" }\n");
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Records how long the phases of a run take (parsing, each statement and the transforms
+// inside it) with counters attached to them, for --stats and --trace. Disabled until
+// enable(), then every ProfileScope costs a branch. Events nest per thread, so a statement
+// run by the worker of a StatementStream is not part of the parse event around it.
+class Profiler {
+public:
+    static constexpr std::uint32_t NoEvent = UINT32_MAX;
+
+    struct Event {
+        const char *  name;
+        std::uint32_t parent; // enclosing event of the same thread or NoEvent
+        std::uint32_t thread; // numbered in the order threads first record an event
+        std::uint64_t start       = 0; // ns since enable()
+        std::uint64_t duration    = 0;
+        std::uint64_t allocations = 0;
+
+        std::vector<std::pair<const char *, std::uint64_t>> counters;
+    };
+
+    static Profiler &global();
+
+    void enable();
+    bool enabled() const { return on; }
+
+    std::uint32_t begin(const char *name); // name has to outlive the profiler
+    void          end(std::uint32_t event);
+    void          counter(std::uint32_t event, const char *name, std::uint64_t value);
+
+    // Allocations are counted by the operator new of allocations.cpp, built with
+    // SATSOLVER_COUNT_ALLOCATIONS, while profiling or once count_allocations() was called
+    void          count_allocations() { counting = true; }
+    std::uint64_t allocation_count() const { return allocations.load(std::memory_order_relaxed); }
+    void          allocated()
+    {
+        if (counting) {
+            allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Events nested as they ran plus totals per event name
+    void write_stats(FILE *out) const;
+    // Chrome trace event format, loads in chrome://tracing and Perfetto
+    void write_trace(FILE *out) const;
+
+private:
+    std::uint64_t now() const;
+
+    bool                                  on       = false;
+    bool                                  counting = false;
+    std::chrono::steady_clock::time_point epoch;
+    mutable std::mutex                    mutex; // events and threads
+    std::vector<Event>                    events;
+    std::uint32_t                         threads = 0;
+    std::atomic<std::uint64_t>            allocations{ 0 };
+};
+
+// Times the enclosing block as one event of the global profiler
+class ProfileScope {
+public:
+    explicit ProfileScope(const char *name)
+    {
+        if (Profiler::global().enabled()) {
+            event = Profiler::global().begin(name);
+        }
+    }
+    ~ProfileScope()
+    {
+        if (event != Profiler::NoEvent) {
+            Profiler::global().end(event);
+        }
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+    // False while profiling is off, counters that cost something to compute check it first
+    bool active() const { return event != Profiler::NoEvent; }
+
+    void counter(const char *name, std::uint64_t value)
+    {
+        if (active()) {
+            Profiler::global().counter(event, name, value);
+        }
+    }
+
+private:
+    std::uint32_t event = Profiler::NoEvent;
+};
@@ -0,0 +1,131 @@
+#include "program.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+Program::Program(const ExpressionStore &store, ExprId expr)
+    : expr(expr)
+{
+    // Count how often every node is referenced from the reachable part of the DAG
+    std::vector<std::uint32_t> refs(store.size());
+    store.visit(expr, [&](ExprId e, const Expression &) { return refs[e]++ == 0; });
+
+    std::unordered_map<AtomId, std::uint32_t> slot;
+    std::vector<std::uint32_t>                temp(store.size(), UINT32_MAX);
+
+    // Emit in postfix order, a shared node is only computed at its first occurrence
+    Traversal<ExprId> traversal;
+    std::size_t       height = 0;
+    traversal.run(
+        expr,
+        [&](ExprId e, const auto &push) {
+            if (temp[e] != UINT32_MAX) {
+                code.push_back({ Recall, temp[e] });
+                depth = std::max(depth, ++height);
+                return false;
+            }
+            const auto &node = store[e];
+            if (node.binary() || node.op == Expression::Neg) {
+                push(node.lhs);
+            }
+            if (node.binary()) {
+                push(node.rhs);
+            }
+            return true;
+        },
+        [&](ExprId e) {
+            const auto &node = store[e];
+            switch (node.op) {
+            case Expression::Pred: {
+                const auto [it, inserted] = slot.try_emplace(node.lhs, static_cast<std::uint32_t>(slots.size()));
+                if (inserted) {
+                    slots.push_back(node.lhs);
+                }
+                code.push_back({ Load, it->second });
+                depth = std::max(depth, ++height);
+                break;
+            }
+            case Expression::Constant:
+                code.push_back({ Push, node.lhs });
+                depth = std::max(depth, ++height);
+                break;
+            case Expression::Neg:
+                code.push_back({ Not, 0 });
+                break;
+            default:
+                code.push_back({ static_cast<Op>(And + node.op), 0 });
+                height--;
+                break;
+            }
+
+            // Shared inner nodes are kept for their later occurrences
+            if (refs[e] > 1 && (node.binary() || node.op == Expression::Neg)) {
+                temp[e] = static_cast<std::uint32_t>(temporaries++);
+                code.push_back({ Save, temp[e] });
+            }
+        });
+}
+
+bool Program::exec(const std::uint8_t *values, std::uint8_t *stack, std::uint8_t *temps) const
+{
+    std::size_t top = 0;
+    for (const auto &ins : code) {
+        switch (ins.op) {
+        case Load:
+            stack[top++] = values[ins.arg];
+            break;
+        case Push:
+            stack[top++] = static_cast<std::uint8_t>(ins.arg);
+            break;
+        case Not:
+            stack[top - 1] = !stack[top - 1];
+            break;
+        case And:
+            top--;
+            stack[top - 1] = stack[top - 1] & stack[top];
+            break;
+        case Or:
+            top--;
+            stack[top - 1] = stack[top - 1] | stack[top];
+            break;
+        case Impl:
+            top--;
+            stack[top - 1] = (!stack[top - 1]) | stack[top];
+            break;
+        case Equiv:
+            top--;
+            stack[top - 1] = stack[top - 1] == stack[top];
+            break;
+        case Save:
+            temps[ins.arg] = stack[top - 1];
+            break;
+        case Recall:
+            stack[top++] = temps[ins.arg];
+            break;
+        }
+    }
+    return stack[0];
+}
+
+bool Program::run(const std::uint8_t *values) const
+{
+    std::vector<std::uint8_t> scratch(depth + temporaries);
+    return exec(values, scratch.data(), scratch.data() + depth);
+}
+
+bool Program::run(const EvaluationContext &ec) const
+{
+    std::vector<std::uint8_t> values(slots.size());
+    for (std::size_t i = 0; i < slots.size(); i++) {
+        values[i] = ec.get(slots[i]);
+    }
+    return run(values.data());
+}
+
+void Program::run(const std::uint8_t *assignments, std::size_t count, std::uint8_t *results) const
+{
+    std::vector<std::uint8_t> scratch(depth + temporaries);
+    for (std::size_t i = 0; i < count; i++) {
+        results[i] = exec(assignments + i * slots.size(), scratch.data(), scratch.data() + depth);
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "ast.h"
+
+#include <cstdint>
+#include <vector>
+
+// An expression lowered to postfix code for a stack machine. Atoms are loaded from dense
+// slots, slot i holds the value of atoms()[i]. Subexpressions that occur more than once in
+// the DAG are computed once and kept in a temporary, so the code is linear in the number of
+// distinct subformulas.
+class Program {
+public:
+    Program(const ExpressionStore &store, ExprId expr);
+
+    ExprId                     root() const { return expr; }
+    const std::vector<AtomId> &atoms() const { return slots; }
+
+    // values[i] is the value of atoms()[i]
+    bool run(const std::uint8_t *values) const;
+
+    // Atoms missing in the context are ff
+    bool run(const EvaluationContext &ec) const;
+
+    // Evaluates count assignments stored row after row, atoms().size() values each
+    void run(const std::uint8_t *assignments, std::size_t count, std::uint8_t *results) const;
+
+private:
+    enum Op : std::uint8_t { Load, Push, Not, And, Or, Impl, Equiv, Save, Recall };
+
+    struct Instruction {
+        Op            op;
+        std::uint32_t arg; // slot of Load, value of Push, temporary of Save and Recall
+    };
+
+    bool exec(const std::uint8_t *values, std::uint8_t *stack, std::uint8_t *temps) const;
+
+    ExprId                   expr;
+    std::vector<AtomId>      slots;
+    std::vector<Instruction> code;
+    std::size_t              depth = 0, temporaries = 0;
+};
@@ -0,0 +1,795 @@
+#include "proof.h"
+#include "profile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_map>
+
+ProofWriter::ProofWriter(FILE *out, ProofFormat format, bool binary)
+    : out(out)
+    , format(format)
+    , binary(binary)
+    , writer([this] { work(); })
+{
+    buffer.reserve(BufferSize);
+}
+
+ProofWriter::~ProofWriter()
+{
+    finish();
+}
+
+void ProofWriter::put_number(std::int64_t value)
+{
+    char digits[24];
+    int  n = 0;
+    if (value < 0) {
+        put('-');
+        value = -value;
+    }
+    do {
+        digits[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (n) {
+        put(digits[--n]);
+    }
+    put(' ');
+}
+
+// Seven bits per byte, least significant first, the high bit set on all but the last
+void ProofWriter::put_varint(std::uint64_t value)
+{
+    while (value > 127) {
+        put(static_cast<char>((value & 127) | 128));
+        value >>= 7;
+    }
+    put(static_cast<char>(value));
+}
+
+// Variable v of the solver is v + 1 in the proof, as in the DIMACS file
+void ProofWriter::put_literal(sat::Lit l)
+{
+    const auto v = static_cast<std::int64_t>(sat::var(l)) + 1;
+    if (binary) {
+        put_varint(2 * static_cast<std::uint64_t>(v) + sat::sign(l));
+    } else {
+        put_number(sat::sign(l) ? -v : v);
+    }
+}
+
+void ProofWriter::put_id(std::uint64_t id)
+{
+    if (binary) {
+        put_varint(2 * id);
+    } else {
+        put_number(static_cast<std::int64_t>(id));
+    }
+}
+
+void ProofWriter::put_end()
+{
+    put(binary ? '\0' : '0');
+}
+
+void ProofWriter::add(std::uint64_t id, const sat::Lit *lits, std::size_t size, const std::vector<std::uint64_t> &hints)
+{
+    last = std::max(last, id);
+    added++;
+    if (binary) {
+        put('a');
+    }
+    if (format == ProofFormat::Lrat) {
+        put_id(id);
+    }
+    for (std::size_t i = 0; i < size; i++) {
+        put_literal(lits[i]);
+    }
+    put_end();
+    if (format == ProofFormat::Lrat) {
+        if (!binary) {
+            put(' ');
+        }
+        for (const auto h : hints) {
+            put_id(h);
+        }
+        put_end();
+    }
+    if (!binary) {
+        put('\n');
+    }
+    if (buffer.size() >= BufferSize) {
+        hand_over();
+    }
+}
+
+void ProofWriter::remove(std::uint64_t id, const sat::Lit *lits, std::size_t size)
+{
+    deleted++;
+    if (binary) {
+        put('d');
+    } else if (format == ProofFormat::Lrat) {
+        put_number(static_cast<std::int64_t>(std::max(last, id)));
+        put('d');
+        put(' ');
+    } else {
+        put('d');
+        put(' ');
+    }
+    if (format == ProofFormat::Lrat) {
+        put_id(id);
+    } else {
+        for (std::size_t i = 0; i < size; i++) {
+            put_literal(lits[i]);
+        }
+    }
+    put_end();
+    if (!binary) {
+        put('\n');
+    }
+    if (buffer.size() >= BufferSize) {
+        hand_over();
+    }
+}
+
+void ProofWriter::hand_over()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return queue.size() < Queued; });
+    queue.push_back(std::move(buffer));
+    if (spare.empty()) {
+        buffer = {};
+        buffer.reserve(BufferSize);
+    } else {
+        buffer = std::move(spare.back());
+        spare.pop_back();
+    }
+    changed.notify_all();
+}
+
+bool ProofWriter::finish()
+{
+    if (!writer.joinable()) {
+        return !failed;
+    }
+    if (!buffer.empty()) {
+        hand_over();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    changed.notify_all();
+    writer.join();
+    failed |= fflush(out) != 0 || ferror(out);
+    return !failed;
+}
+
+void ProofWriter::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        changed.wait(lock, [this] { return done || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+        auto chunk = std::move(queue.front());
+        queue.pop_front();
+
+        lock.unlock();
+        const bool complete = fwrite(chunk.data(), 1, chunk.size(), out) == chunk.size();
+        lock.lock();
+
+        failed |= !complete;
+        written += chunk.size();
+        chunk.clear();
+        spare.push_back(std::move(chunk));
+        changed.notify_all();
+    }
+}
+
+namespace {
+
+struct Step {
+    bool                       deletion = false;
+    std::uint64_t              id       = 0; // LRAT
+    std::vector<sat::Lit>      lits;
+    std::vector<std::uint64_t> hints; // LRAT, the clauses deleted for a deletion
+    bool                       rat = false; // some hint was negative
+};
+
+// Steps of a proof file in any of the four encodings
+class ProofReader {
+public:
+    ProofReader(FILE *in, ProofFormat format, bool binary)
+        : in(in)
+        , format(format)
+        , binary(binary)
+    {
+    }
+
+    // False at the end of the proof, and with error set if a step is malformed
+    bool next(Step &step)
+    {
+        step.deletion = false;
+        step.id       = 0;
+        step.rat      = false;
+        step.lits.clear();
+        step.hints.clear();
+        return binary ? next_binary(step) : next_text(step);
+    }
+
+    std::string error;
+
+private:
+    int get()
+    {
+        if (pos == size) {
+            size = fread(buffer, 1, sizeof(buffer), in);
+            pos  = 0;
+            if (size == 0) {
+                return EOF;
+            }
+        }
+        return static_cast<unsigned char>(buffer[pos++]);
+    }
+    void unget() { pos--; }
+
+    // Skips blanks and comment lines, the next character or EOF
+    int peek()
+    {
+        for (;;) {
+            int c = get();
+            if (c == 'c') {
+                while (c != EOF && c != '\n') {
+                    c = get();
+                }
+            }
+            if (c == EOF) {
+                return EOF;
+            } else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+                unget();
+                return c;
+            }
+        }
+    }
+
+    bool number(std::int64_t &value)
+    {
+        int        c        = peek();
+        const bool negative = c == '-';
+        if (negative) {
+            get();
+            c = get();
+        } else {
+            c = get();
+        }
+        if (c < '0' || c > '9') {
+            return fail("expected a number");
+        }
+        value = 0;
+        for (; c >= '0' && c <= '9'; c = get()) {
+            value = value * 10 + (c - '0');
+            if (value > INT64_MAX / 10) {
+                return fail("number out of range");
+            }
+        }
+        if (c != EOF) {
+            unget();
+        }
+        value = negative ? -value : value;
+        return true;
+    }
+
+    bool varint(std::uint64_t &value)
+    {
+        value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            const int c = get();
+            if (c == EOF) {
+                return fail("truncated number");
+            }
+            value |= static_cast<std::uint64_t>(c & 127) << shift;
+            if (!(c & 128)) {
+                return true;
+            }
+        }
+        return fail("number out of range");
+    }
+
+    bool literal(std::int64_t x, std::vector<sat::Lit> &lits)
+    {
+        const auto v = x < 0 ? -x : x;
+        if (v > INT32_MAX) {
+            return fail("variable out of range");
+        }
+        lits.push_back(sat::mklit(static_cast<sat::Var>(v - 1), x < 0));
+        return true;
+    }
+
+    bool hint(std::int64_t h, Step &step)
+    {
+        step.rat |= h < 0;
+        step.hints.push_back(static_cast<std::uint64_t>(h < 0 ? -h : h));
+        return true;
+    }
+
+    bool next_text(Step &step)
+    {
+        if (peek() == EOF) {
+            return false;
+        }
+        std::int64_t x;
+        if (format == ProofFormat::Lrat) {
+            if (!number(x) || x <= 0) {
+                return fail("expected a clause id");
+            }
+            step.id = static_cast<std::uint64_t>(x);
+        }
+        if (peek() == 'd') {
+            get();
+            step.deletion = true;
+        }
+        if (step.deletion && format == ProofFormat::Lrat) {
+            while (number(x) && x != 0) {
+                hint(x, step);
+            }
+            return error.empty();
+        }
+        while (number(x) && x != 0) {
+            literal(x, step.lits);
+        }
+        if (format == ProofFormat::Lrat && !step.deletion && error.empty()) {
+            while (number(x) && x != 0) {
+                hint(x, step);
+            }
+        }
+        return error.empty();
+    }
+
+    bool next_binary(Step &step)
+    {
+        const int c = get();
+        if (c == EOF) {
+            return false;
+        } else if (c != 'a' && c != 'd') {
+            return fail("expected 'a' or 'd'");
+        }
+        step.deletion = c == 'd';
+
+        std::uint64_t u;
+        if (format == ProofFormat::Lrat) {
+            if (step.deletion) {
+                while (varint(u) && u != 0) {
+                    hint(static_cast<std::int64_t>(u >> 1), step);
+                }
+                return error.empty();
+            }
+            if (!varint(u) || u < 2) {
+                return fail("expected a clause id");
+            }
+            step.id = u >> 1;
+        }
+        while (varint(u) && u != 0) {
+            if (u < 2) {
+                return fail("expected a literal");
+            }
+            const auto v = static_cast<std::int64_t>(u >> 1);
+            literal(u & 1 ? -v : v, step.lits);
+        }
+        if (format == ProofFormat::Lrat && error.empty()) {
+            while (varint(u) && u != 0) {
+                const auto h = static_cast<std::int64_t>(u >> 1);
+                hint(u & 1 ? -h : h, step);
+            }
+        }
+        return error.empty();
+    }
+
+    bool fail(const char *what)
+    {
+        if (error.empty()) {
+            error = what;
+        }
+        return false;
+    }
+
+    FILE *      in;
+    ProofFormat format;
+    bool        binary;
+    char        buffer[1 << 16];
+    std::size_t pos = 0, size = 0;
+};
+
+// Forward DRAT checking: every added clause has to follow from the clauses so far by unit
+// propagation. Units the clauses imply are kept once found, deleting the clauses they came
+// from does not take them back. That is sound as long as every clause is implied, which RUP
+// steps guarantee.
+class DratChecker {
+public:
+    explicit DratChecker(const Cnf &cnf)
+    {
+        std::vector<sat::Lit> lits;
+        for (std::size_t c = 0; c < cnf.size(); c++) {
+            lits.assign(cnf[c].begin(), cnf[c].end());
+            add(lits);
+        }
+    }
+
+    // Whether lits follows by unit propagation
+    bool implied(std::vector<sat::Lit> &lits)
+    {
+        if (inconsistent) {
+            return true;
+        }
+        for (const auto l : lits) {
+            grow(sat::var(l));
+        }
+        const auto root     = trail.size();
+        bool       conflict = false;
+        for (const auto l : lits) {
+            if (value[l] > 0) {
+                conflict = true; // ¬lits contradicts the root units
+                break;
+            } else if (value[l] == 0) {
+                assign(sat::neg(l));
+            }
+        }
+        conflict = conflict || propagate();
+
+        for (auto k = root; k < trail.size(); k++) {
+            value[trail[k]] = value[sat::neg(trail[k])] = 0;
+        }
+        trail.resize(root);
+        head = root;
+        return conflict;
+    }
+
+    void add(std::vector<sat::Lit> &lits)
+    {
+        normalize(lits);
+        for (const auto l : lits) {
+            grow(sat::var(l));
+        }
+        if (inconsistent || tautology(lits)) {
+            return;
+        }
+
+        const auto ref = static_cast<std::uint32_t>(arena.size());
+        arena.push_back(static_cast<sat::Lit>(lits.size()));
+        arena.push_back(0);
+        arena.insert(end(arena), begin(lits), end(lits));
+        index[hash(lits)].push_back(ref);
+
+        // Watch two literals that are not false at the root, a clause without them is a
+        // unit or the conflict
+        auto *c    = &arena[ref + 2];
+        int   free = 0;
+        for (std::size_t k = 0; k < lits.size() && free < 2; k++) {
+            if (value[c[k]] >= 0) {
+                std::swap(c[free++], c[k]);
+            }
+        }
+        if (free == 0) {
+            inconsistent = true;
+        } else if (free == 1) {
+            if (value[c[0]] == 0) {
+                assign(c[0]);
+                inconsistent = propagate();
+            }
+        } else {
+            watches[c[0]].push_back(ref);
+            watches[c[1]].push_back(ref);
+        }
+    }
+
+    // False if no such clause is there, which drat-trim only warns about
+    bool remove(std::vector<sat::Lit> &lits)
+    {
+        normalize(lits);
+        const auto it = index.find(hash(lits));
+        if (it == end(index)) {
+            return false;
+        }
+        auto &refs = it->second;
+        for (std::size_t i = 0; i < refs.size(); i++) {
+            const auto ref = refs[i];
+            if (arena[ref] == lits.size() && std::is_permutation(begin(lits), end(lits), &arena[ref + 2])) {
+                arena[ref + 1] = 1; // watches drop it lazily
+                refs.erase(begin(refs) + i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool inconsistent = false;
+
+private:
+    static void normalize(std::vector<sat::Lit> &lits)
+    {
+        std::sort(begin(lits), end(lits));
+        lits.erase(std::unique(begin(lits), end(lits)), end(lits));
+    }
+
+    static bool tautology(const std::vector<sat::Lit> &lits)
+    {
+        for (std::size_t k = 1; k < lits.size(); k++) {
+            if (lits[k] == sat::neg(lits[k - 1])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Of the sorted literals
+    static std::uint64_t hash(const std::vector<sat::Lit> &lits)
+    {
+        std::uint64_t h = 0xcbf29ce484222325ull;
+        for (const auto l : lits) {
+            h = (h ^ l) * 0x100000001b3ull;
+        }
+        return h;
+    }
+
+    void grow(sat::Var v)
+    {
+        if (2 * static_cast<std::size_t>(v) + 2 > value.size()) {
+            value.resize(2 * static_cast<std::size_t>(v) + 2, 0);
+            watches.resize(value.size());
+        }
+    }
+
+    void assign(sat::Lit l)
+    {
+        value[l]           = 1;
+        value[sat::neg(l)] = -1;
+        trail.push_back(l);
+    }
+
+    // True on a conflict
+    bool propagate()
+    {
+        while (head < trail.size()) {
+            const auto  falselit = sat::neg(trail[head++]);
+            auto &      ws       = watches[falselit];
+            std::size_t i = 0, j = 0;
+            for (; i < ws.size(); i++) {
+                const auto ref = ws[i];
+                if (arena[ref + 1]) {
+                    continue;
+                }
+                auto *     c    = &arena[ref + 2];
+                const auto size = arena[ref];
+                if (c[0] == falselit) {
+                    std::swap(c[0], c[1]);
+                }
+                if (value[c[0]] > 0) {
+                    ws[j++] = ref;
+                    continue;
+                }
+                bool moved = false;
+                for (std::uint32_t k = 2; k < size; k++) {
+                    if (value[c[k]] >= 0) {
+                        std::swap(c[1], c[k]);
+                        watches[c[1]].push_back(ref);
+                        moved = true;
+                        break;
+                    }
+                }
+                if (moved) {
+                    continue;
+                }
+                ws[j++] = ref;
+                if (value[c[0]] < 0) {
+                    for (i++; i < ws.size(); i++) {
+                        ws[j++] = ws[i];
+                    }
+                    ws.resize(j);
+                    return true;
+                }
+                assign(c[0]);
+            }
+            ws.resize(j);
+        }
+        return false;
+    }
+
+    std::vector<sat::Lit>                                        arena; // size, deleted, literals
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> index;
+    std::vector<std::vector<std::uint32_t>>                      watches; // by literal watched
+    std::vector<std::int8_t>                                     value; // by literal, 1 true, -1 false
+    std::vector<sat::Lit>                                        trail; // true literals, the root units first
+    std::size_t                                                  head = 0;
+};
+
+// LRAT checking: the hints of a step, propagated in their order under the negation of the
+// new clause, have to end in a conflict, each of them unit before that
+class LratChecker {
+public:
+    explicit LratChecker(const Cnf &cnf)
+    {
+        for (std::size_t c = 0; c < cnf.size(); c++) {
+            store(c + 1, cnf[c].begin(), cnf[c].end());
+        }
+    }
+
+    // Empty if the step holds
+    const char *check(const Step &step)
+    {
+        if (step.rat) {
+            return "RAT steps are not supported";
+        }
+        if (index.count(step.id)) {
+            return "clause id already in use";
+        }
+        for (const auto l : step.lits) {
+            grow(sat::var(l));
+        }
+
+        const char *error = "the hints end without a conflict";
+        bool        done  = false;
+        for (const auto l : step.lits) {
+            if (value[l] < 0) {
+                continue;
+            } else if (value[l] > 0) {
+                done = true; // a tautology
+                break;
+            }
+            assign(sat::neg(l));
+        }
+        for (std::size_t h = 0; h < step.hints.size() && !done; h++) {
+            const auto it = index.find(step.hints[h]);
+            if (it == end(index)) {
+                error = "a hint refers to no clause";
+                break;
+            }
+            const auto *c    = &arena[it->second + 1];
+            const auto  size = arena[it->second];
+            sat::Lit    unit = sat::UndefLit;
+            int         open = 0;
+            for (std::uint32_t k = 0; k < size && open < 2; k++) {
+                if (value[c[k]] > 0) {
+                    open = 2;
+                } else if (value[c[k]] == 0 && c[k] != unit) { // clauses may repeat literals
+                    unit = c[k];
+                    open++;
+                }
+            }
+            if (open == 0) {
+                done = true;
+            } else if (open == 1) {
+                assign(unit);
+            } else {
+                error = "a hint is not unit";
+                break;
+            }
+        }
+
+        for (const auto l : trail) {
+            value[l] = value[sat::neg(l)] = 0;
+        }
+        trail.clear();
+        if (!done) {
+            return error;
+        }
+        store(step.id, begin(step.lits), end(step.lits));
+        return nullptr;
+    }
+
+    void remove(std::uint64_t id) { index.erase(id); }
+
+private:
+    template<typename It>
+    void store(std::uint64_t id, It first, It last)
+    {
+        index[id] = static_cast<std::uint32_t>(arena.size());
+        arena.push_back(static_cast<sat::Lit>(last - first));
+        for (; first != last; ++first) {
+            grow(sat::var(*first));
+            arena.push_back(*first);
+        }
+    }
+
+    void grow(sat::Var v)
+    {
+        if (2 * static_cast<std::size_t>(v) + 2 > value.size()) {
+            value.resize(2 * static_cast<std::size_t>(v) + 2, 0);
+        }
+    }
+
+    void assign(sat::Lit l)
+    {
+        value[l]           = 1;
+        value[sat::neg(l)] = -1;
+        trail.push_back(l);
+    }
+
+    std::vector<sat::Lit>                           arena; // size, literals
+    std::unordered_map<std::uint64_t, std::uint32_t> index; // clauses not deleted by id
+    std::vector<std::int8_t>                        value;
+    std::vector<sat::Lit>                           trail;
+};
+}
+
+ProofCheck check_proof(const Cnf &cnf, FILE *proof, ProofFormat format, bool binary)
+{
+    ProfileScope scope("check_proof");
+    ProofCheck   result;
+    ProofReader  reader(proof, format, binary);
+    Step         step;
+
+    const auto fail = [&](std::uint64_t n, const char *what) {
+        result.verified = false;
+        result.error    = "step " + std::to_string(n) + ": " + what;
+        return result;
+    };
+
+    std::uint64_t n = 1;
+    if (format == ProofFormat::Drat) {
+        DratChecker checker(cnf);
+        for (; reader.next(step); n++) {
+            if (step.deletion) {
+                checker.remove(step.lits);
+                result.deletions++;
+                continue;
+            }
+            if (!checker.implied(step.lits)) {
+                return fail(n, "the clause does not follow by unit propagation");
+            }
+            result.verified |= step.lits.empty();
+            checker.add(step.lits);
+            result.additions++;
+        }
+    } else {
+        LratChecker checker(cnf);
+        for (; reader.next(step); n++) {
+            if (step.deletion) {
+                for (const auto id : step.hints) {
+                    checker.remove(id);
+                }
+                result.deletions++;
+                continue;
+            }
+            if (const auto error = checker.check(step)) {
+                return fail(n, error);
+            }
+            result.verified |= step.lits.empty();
+            result.additions++;
+        }
+    }
+    if (!reader.error.empty()) {
+        return fail(n, reader.error.c_str());
+    }
+    if (!result.verified) {
+        result.error = "the empty clause is never derived";
+    }
+    scope.counter("additions", result.additions);
+    scope.counter("deletions", result.deletions);
+    return result;
+}
+
+PortfolioResult solve_certified(const Cnf &cnf, ProofCheck &certificate)
+{
+    char *          buffer = nullptr;
+    std::size_t     size   = 0;
+    FILE *          out    = open_memstream(&buffer, &size);
+    PortfolioResult result;
+    {
+        ProofWriter proof(out, ProofFormat::Lrat, true);
+        result = solve_portfolio(cnf, 1, &proof);
+        proof.finish();
+    }
+    fclose(out);
+
+    if (result.result == sat::Result::Unsat) {
+        if (FILE *in = size ? fmemopen(buffer, size, "r") : nullptr) {
+            certificate = check_proof(cnf, in, ProofFormat::Lrat, true);
+            fclose(in);
+        } else {
+            certificate.error = "no proof";
+        }
+    }
+    free(buffer);
+    return result;
+}
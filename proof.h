@@ -0,0 +1,87 @@
+#pragma once
+#include "cnf.h"
+#include "portfolio.h"
+#include "solver.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// DRAT lists the clauses a solver added and deleted, a checker has to find out by unit
+// propagation why each one follows. LRAT numbers the clauses and gives the clauses to
+// propagate with every addition, checking it is a replay. Both come as text or in the binary
+// encoding of drat-trim, which is about a third of the size.
+enum class ProofFormat { Drat, Lrat };
+
+// Proof output of a solver, written to a file by a thread of its own. The solver encodes
+// steps into a buffer, full buffers are queued for the writer. Up to Queued of them wait,
+// after that the solver blocks until the file catches up.
+class ProofWriter : public sat::ProofSink {
+public:
+    static constexpr std::size_t BufferSize = 1 << 20;
+    static constexpr std::size_t Queued     = 4;
+
+    ProofWriter(FILE *out, ProofFormat format, bool binary);
+    ~ProofWriter() override;
+
+    ProofWriter(const ProofWriter &) = delete;
+    ProofWriter &operator=(const ProofWriter &) = delete;
+
+    bool hints() const override { return format == ProofFormat::Lrat; }
+    void add(std::uint64_t id, const sat::Lit *lits, std::size_t size, const std::vector<std::uint64_t> &hints) override;
+    void remove(std::uint64_t id, const sat::Lit *lits, std::size_t size) override;
+
+    // Writes what is left and stops the writer, false if a write failed
+    bool finish();
+
+    std::uint64_t additions() const { return added; }
+    std::uint64_t deletions() const { return deleted; }
+    std::uint64_t bytes() const { return written; } // after finish()
+
+private:
+    void put(char c) { buffer.push_back(c); }
+    void put_number(std::int64_t value); // text
+    void put_varint(std::uint64_t value); // binary
+    void put_literal(sat::Lit l);
+    void put_id(std::uint64_t id);
+    void put_end();
+    void hand_over();
+    void work();
+
+    FILE *                         out;
+    ProofFormat                    format;
+    bool                           binary;
+    std::vector<char>              buffer;
+    std::uint64_t                  last  = 0; // latest id, LRAT deletion lines start with it
+    std::uint64_t                  added = 0, deleted = 0;
+    std::mutex                     mutex; // everything below
+    std::uint64_t                  written = 0;
+    std::condition_variable        changed;
+    std::deque<std::vector<char>>  queue;
+    std::vector<std::vector<char>> spare; // written buffers, reused by hand_over()
+    bool                           done   = false;
+    bool                           failed = false;
+    std::thread                    writer;
+};
+
+struct ProofCheck {
+    bool          verified  = false; // every step checked and the empty clause derived
+    std::uint64_t additions = 0;
+    std::uint64_t deletions = 0;
+    std::string   error; // why not, with the number of the step
+};
+
+// Checks that proof refutes cnf. Only steps that follow by unit propagation (RUP) are
+// accepted, which is all the solver writes: RAT steps are reported as errors. DRAT is
+// checked forward with watched literals, LRAT by replaying the hints of every step.
+ProofCheck check_proof(const Cnf &cnf, FILE *proof, ProofFormat format, bool binary);
+
+// What --check does for unsatisfiable answers: solves cnf on a single solver with an LRAT
+// proof kept in memory and checks that against cnf. certificate is only filled in for
+// Result::Unsat.
+PortfolioResult solve_certified(const Cnf &cnf, ProofCheck &certificate);
@@ -1,22 +1,379 @@
 #include "ast.h"
+#include "batch.h"
+#include "dimacs.h"
+#include "incremental.h"
+#include "localsearch.h"
 #include "parser.hpp"
+#include "portfolio.h"
+#include "preprocess.h"
+#include "profile.h"
+#include "proof.h"
+#include "server.h"
+#include "stream.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
 
-extern FILE * yyin;
-StatementList finalstmtlist;
+static bool write_profile(const char *path, void (Profiler::*write)(FILE *) const)
+{
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        return false;
+    }
+    (Profiler::global().*write)(out);
+    fclose(out);
+    return true;
+}
+
+// Where the proof of an unsatisfiable DIMACS file goes, or which proof --check-proof checks
+struct ProofOptions {
+    const char *path   = nullptr;
+    ProofFormat format = ProofFormat::Drat;
+    bool        binary = false;
+    bool        check  = false;
+};
+
+// Checks a proof of the DIMACS file, answers "s VERIFIED" with exit code 0 or
+// "s NOT VERIFIED" with exit code 1
+static int check_dimacs(const char *path, const ProofOptions &proof)
+{
+    const auto start = std::chrono::steady_clock::now();
+    Cnf        cnf;
+    if (!read_dimacs(path, cnf)) {
+        return 1;
+    }
+    FILE *in = std::strcmp(proof.path, "-") == 0 ? stdin : fopen(proof.path, "r");
+    if (!in) {
+        perror(proof.path);
+        return 1;
+    }
+    const auto result = check_proof(cnf, in, proof.format, proof.binary);
+    if (in != stdin) {
+        fclose(in);
+    }
+
+    printf("c %llu additions, %llu deletions, checked in %.3f ms\n", static_cast<unsigned long long>(result.additions),
+           static_cast<unsigned long long>(result.deletions),
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    if (!result.verified) {
+        printf("c %s\ns NOT VERIFIED\n", result.error.c_str());
+        return 1;
+    }
+    printf("s VERIFIED\n");
+    return 0;
+}
+
+// Solves a DIMACS file and answers in the format of the SAT competition, exit code 10 for
+// satisfiable and 20 for unsatisfiable instances. A proof is for the clauses of the file, it
+// rules out preprocessing and runs a single solver. A proof on stdout moves the answer to
+// stderr, the proof writer owns stdout then.
+static int solve_dimacs(const char *path, unsigned threads, bool preprocess, const ProofOptions &proof)
+{
+    const auto start = std::chrono::steady_clock::now();
+    FILE *     out   = proof.path && std::strcmp(proof.path, "-") == 0 ? stderr : stdout;
+    Cnf        cnf;
+    {
+        ProfileScope scope("parse");
+        if (!read_dimacs(path, cnf)) {
+            return 1;
+        }
+        scope.counter("clauses", cnf.size());
+    }
+    const auto parsed = std::chrono::steady_clock::now();
+
+    FILE *                       proof_file = nullptr;
+    std::unique_ptr<ProofWriter> writer;
+    if (proof.path) {
+        if (!(proof_file = std::strcmp(proof.path, "-") == 0 ? stdout : fopen(proof.path, "w"))) {
+            perror(proof.path);
+            return 1;
+        }
+        writer = std::make_unique<ProofWriter>(proof_file, proof.format, proof.binary);
+        if (preprocess) {
+            fprintf(out, "c no preprocessing with a proof\n");
+            preprocess = false;
+        }
+    }
+
+    // Preprocessing keeps the variables, models of the simplified clauses are extended below
+    std::unique_ptr<Preprocessor> pre;
+    Cnf                           simplified;
+    if (preprocess) {
+        pre        = std::make_unique<Preprocessor>(cnf);
+        simplified = pre->run({});
+        fprintf(out, "c preprocessed ");
+        print_stats(pre->stats(), out);
+        fprintf(out, " in %.3f ms\n", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - parsed).count());
+    }
+
+    auto       result = solve_portfolio(pre ? simplified : cnf, threads, writer.get());
+    const auto solved = std::chrono::steady_clock::now();
+    if (pre && result.result == sat::Result::Sat) {
+        pre->extend(result.model);
+    }
+
+    fprintf(out, "c %zu variables, %zu clauses, parsed in %.3f ms, solved in %.3f ms\n", cnf.atoms.size(), cnf.size(),
+            std::chrono::duration<double, std::milli>(parsed - start).count(),
+            std::chrono::duration<double, std::milli>(solved - parsed).count());
+    if (threads > 1 && !writer) {
+        fprintf(out, "c worker %u of %u finished first after %llu conflicts\n", result.winner, threads,
+                static_cast<unsigned long long>(result.stats.conflicts));
+    }
+    if (writer) {
+        // The writer ran alongside the solver, this is only what was still queued
+        const bool written = writer->finish();
+        fprintf(out, "c proof: %llu additions, %llu deletions, %llu bytes, flushed in %.3f ms\n",
+                static_cast<unsigned long long>(writer->additions()), static_cast<unsigned long long>(writer->deletions()),
+                static_cast<unsigned long long>(writer->bytes()),
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - solved).count());
+        if (proof_file != stdout) {
+            fclose(proof_file);
+        }
+        if (!written) {
+            fprintf(stderr, "%s: writing the proof failed\n", proof.path);
+            return 1;
+        }
+    }
+    if (result.result != sat::Result::Sat) {
+        fprintf(out, "s UNSATISFIABLE\n");
+        return 20;
+    }
+
+    fprintf(out, "s SATISFIABLE\nv");
+    for (std::size_t v = 0; v < cnf.atoms.size(); v++) {
+        fprintf(out, " %s%zu", result.model[v] ? "" : "-", v + 1);
+    }
+    fprintf(out, " 0\n");
+    return 10;
+}
+
+// Looks for a model of a DIMACS file by local search, exit code 10 if one turns up. Without
+// one the answer is "s UNKNOWN" with exit code 0, local search never shows unsatisfiability.
+static int walk_dimacs(const char *path, unsigned threads, const WalkOptions &options)
+{
+    const auto start = std::chrono::steady_clock::now();
+    Cnf        cnf;
+    {
+        ProfileScope scope("parse");
+        if (!read_dimacs(path, cnf)) {
+            return 1;
+        }
+        scope.counter("clauses", cnf.size());
+    }
+    const auto parsed = std::chrono::steady_clock::now();
+    const auto result = local_search(cnf, options, threads);
+    const auto walked = std::chrono::steady_clock::now();
+
+    printf("c %zu variables, %zu clauses, parsed in %.3f ms, walked in %.3f ms\n", cnf.atoms.size(), cnf.size(),
+           std::chrono::duration<double, std::milli>(parsed - start).count(),
+           std::chrono::duration<double, std::milli>(walked - parsed).count());
+    printf("c %llu flips", static_cast<unsigned long long>(result.flips));
+    if (threads > 1 && result.found) {
+        printf(", walker %u of %u found the model", result.winner, threads);
+    }
+    printf("\n");
+    if (!result.found) {
+        printf("s UNKNOWN\n");
+        return 0;
+    }
+
+    printf("s SATISFIABLE\nv");
+    for (std::size_t v = 0; v < cnf.atoms.size(); v++) {
+        printf(" %s%zu", result.model[v] ? "" : "-", v + 1);
+    }
+    printf(" 0\n");
+    return 10;
+}
+
+// One path per line, for batches too long for the command line
+static bool read_file_list(const char *path, std::vector<std::string> &scripts)
+{
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return false;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), in)) {
+        line[std::strcspn(line, "\r\n")] = 0;
+        if (line[0]) {
+            scripts.push_back(line);
+        }
+    }
+    fclose(in);
+    return true;
+}
 
 int main(int argc, char **argv)
 {
-    if (argc == 2) {
-        yyin = fopen(argv[1], "r");
+    std::vector<std::string> scripts;
+    const char *             cnf         = nullptr;
+    const char *             stats       = nullptr;
+    const char *             trace       = nullptr;
+    bool                     incremental = false;
+    bool                     walk        = false;
+    bool                     stream      = false;
+    unsigned                 jobs        = 0; // batch workers, 0 runs a single script without a batch
+    bool                     serve       = false;
+    const char *             socket      = nullptr;
+    std::size_t              cache       = QueryServer::Options{}.cache;
+    ProofOptions             proof;
+    WalkOptions              walk_options;
+    EvaluationContext        ec;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--cnf") == 0 && i + 1 < argc) {
+            cnf = argv[++i];
+        } else if (std::strcmp(argv[i], "--dimacs") == 0) {
+            ec.dimacs = true;
+        } else if (std::strcmp(argv[i], "--incremental") == 0) {
+            incremental = true;
+        } else if (std::strcmp(argv[i], "--stream") == 0) {
+            stream = true;
+        } else if (std::strcmp(argv[i], "--preprocess") == 0) {
+            ec.preprocess = true;
+        } else if (std::strcmp(argv[i], "--check") == 0) {
+            ec.check = true;
+        } else if (std::strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            stats = argv[++i];
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace = argv[++i];
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            ec.threads = static_cast<unsigned>(std::max(1l, std::strtol(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = static_cast<unsigned>(std::max(1l, std::strtol(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--files") == 0 && i + 1 < argc) {
+            if (!read_file_list(argv[++i], scripts)) {
+                return 1;
+            }
+            jobs = jobs ? jobs : std::max(1u, std::thread::hardware_concurrency());
+        } else if (std::strcmp(argv[i], "--serve") == 0) {
+            serve = true;
+        } else if (std::strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            serve  = true;
+            socket = argv[++i];
+        } else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache = static_cast<std::size_t>(std::max(1l, std::strtol(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--proof") == 0 && i + 1 < argc) {
+            proof.path = argv[++i];
+        } else if (std::strcmp(argv[i], "--check-proof") == 0 && i + 1 < argc) {
+            proof.path  = argv[++i];
+            proof.check = true;
+        } else if (std::strcmp(argv[i], "--lrat") == 0) {
+            proof.format = ProofFormat::Lrat;
+        } else if (std::strcmp(argv[i], "--binary") == 0) {
+            proof.binary = true;
+        } else if (std::strcmp(argv[i], "--walk") == 0) {
+            walk = true;
+        } else if (std::strcmp(argv[i], "--walksat") == 0) {
+            walk_options.heuristic = WalkOptions::WalkSat;
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            walk_options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--flips") == 0 && i + 1 < argc) {
+            walk_options.flips = std::strtoull(argv[++i], nullptr, 10);
+        } else if (argv[i][0] == '-' && argv[i][1]) {
+            fprintf(stderr,
+                    "usage: %s [--threads n] [--incremental] [--preprocess] [--dimacs] [--check] [--stream] [--stats file] [--trace file]\n"
+                    "          [script]\n"
+                    "       %s [--jobs n] [--threads n] [--incremental] [--preprocess] [--dimacs] [--check] [--stats file] [--trace file]\n"
+                    "          [--files list] script...\n"
+                    "       %s [--threads n] [--incremental] [--preprocess] [--dimacs] [--check] [--cache n] --serve | --socket path\n"
+                    "       %s [--threads n] [--preprocess] [--stats file] [--trace file] [--proof file [--lrat] [--binary]] --cnf file.cnf\n"
+                    "       %s --check-proof file [--lrat] [--binary] --cnf file.cnf\n"
+                    "       %s [--threads n] [--walksat] [--seed n] [--flips n] [--stats file] [--trace file] --walk --cnf file.cnf\n"
+                    "  --walksat, --seed and --flips configure print walk in scripts too\n",
+                    argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        } else {
+            scripts.push_back(argv[i]);
+        }
+    }
+    // Several scripts always run as a batch. hardware_concurrency() is 0 where it is not known,
+    // a batch then still gets a worker.
+    if (scripts.size() > 1 && !jobs) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    ec.walk = std::make_shared<WalkOptions>(walk_options);
+    if (stats || trace) {
+        Profiler::global().enable();
+    }
+    // Both files are written whatever the exit code, an unsatisfiable run is profiled too
+    const auto finish = [&](int code) {
+        if (stats && !write_profile(stats, &Profiler::write_stats)) {
+            return 1;
+        }
+        if (trace && !write_profile(trace, &Profiler::write_trace)) {
+            return 1;
+        }
+        return code;
+    };
+    if (cnf && proof.check) {
+        return finish(check_dimacs(cnf, proof));
+    }
+    if (cnf && walk) {
+        return finish(walk_dimacs(cnf, ec.threads, walk_options));
+    }
+    if (cnf) {
+        return finish(solve_dimacs(cnf, ec.threads, ec.preprocess, proof));
     }
 
-    yy::parser parser;
-    parser.parse();
-    finalstmtlist.run();
+    if (serve) {
+        QueryServer::Options options;
+        options.cache       = cache;
+        options.incremental = incremental;
+        options.ec          = ec;
+        QueryServer server(std::move(options));
+        if (socket) {
+            return finish(server.listen(socket) ? 0 : 1);
+        }
+        server.serve(stdin, stdout);
+        return finish(0);
+    }
 
-    if (argc == 2) {
-        fclose(yyin);
+    if (jobs) {
+        Batch batch(std::move(scripts), ec, incremental);
+        return finish(batch.run(jobs) ? 1 : 0);
     }
-    return 0;
+
+    FILE *in = stdin;
+    if (!scripts.empty() && !(in = fopen(scripts[0].c_str(), "r"))) {
+        perror(scripts[0].c_str());
+        return finish(1);
+    }
+
+    ExpressionStore store;
+    if (incremental) {
+        ec.incremental = std::make_shared<IncrementalSolver>(store);
+    }
+    if (stream) {
+        // Statements run while the rest of the script is parsed, up to a parse error
+        StatementStream statements(ec);
+        {
+            ProfileScope scope("parse");
+            parse_script(in, store, statements);
+        }
+        statements.finish();
+    } else {
+        StatementList statements;
+        bool          parsed;
+        {
+            ProfileScope scope("parse");
+            parsed = parse_script(in, store, statements);
+            scope.counter("nodes", store.size());
+            scope.counter("statements", statements.statements.size());
+        }
+        if (parsed) {
+            statements.run(ec);
+        }
+    }
+
+    if (in != stdin) {
+        fclose(in);
+    }
+    return finish(0);
 }
@@ -0,0 +1,290 @@
+#include "server.h"
+#include "incremental.h"
+#include "parser.hpp"
+#include "profile.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+void LatencyHistogram::add(std::chrono::steady_clock::duration latency)
+{
+    const auto  ns     = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+    auto        us     = ns / 1000;
+    std::size_t bucket = 0;
+    while (us && bucket + 1 < buckets.size()) {
+        us >>= 1;
+        bucket++;
+    }
+    buckets[bucket]++;
+    n++;
+    max = std::max(max, ns);
+}
+
+std::uint64_t LatencyHistogram::percentile(double p) const
+{
+    const auto    rank = static_cast<std::uint64_t>(p * n);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen > rank) {
+            return std::uint64_t(1) << i;
+        }
+    }
+    return std::uint64_t(1) << (buckets.size() - 1);
+}
+
+void LatencyHistogram::write(FILE *out, const char *name) const
+{
+    fprintf(out, "%-20s %8llu  p50 < %llu us  p90 < %llu us  p99 < %llu us  max %.3f ms\n", name, static_cast<unsigned long long>(n),
+            static_cast<unsigned long long>(percentile(0.5)), static_cast<unsigned long long>(percentile(0.9)),
+            static_cast<unsigned long long>(percentile(0.99)), max / 1e6);
+}
+
+// Runs of whitespace become one space, none is left at either end. Predicates are case
+// sensitive, so that is all two requests may differ in.
+static std::string canonical(const std::string &line)
+{
+    std::string text;
+    for (const char c : line) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            if (!text.empty() && text.back() != ' ') {
+                text += ' ';
+            }
+        } else {
+            text += c;
+        }
+    }
+    if (!text.empty() && text.back() == ' ') {
+        text.pop_back();
+    }
+    return text;
+}
+
+QueryServer::QueryServer(Options options)
+    : options(std::move(options))
+    , store(std::make_unique<ExpressionStore>())
+{
+    this->options.cache = std::max<std::size_t>(this->options.cache, 1);
+}
+
+QueryServer::~QueryServer()
+{
+    // Statements point into the store
+    entries.clear();
+}
+
+void QueryServer::reset()
+{
+    index.clear();
+    entries.clear();
+    store = std::make_unique<ExpressionStore>();
+    generation++;
+    resets++;
+}
+
+QueryServer::Entry *QueryServer::lookup(const std::string &text, std::string &errors)
+{
+    const auto hash = std::hash<std::string>{}(text);
+    if (const auto it = index.find(hash); it != end(index)) {
+        if (it->second->text == text) {
+            hits++;
+            entries.splice(begin(entries), entries, it->second);
+            return &entries.front();
+        }
+        entries.erase(it->second); // collision, the newer request takes the slot
+        index.erase(it);
+    }
+    misses++;
+
+    if (store->size() > options.max_nodes) {
+        reset();
+    }
+
+    ProfileScope  scope("parse");
+    const auto    start = std::chrono::steady_clock::now();
+    StatementList statements;
+    char *        buffer = nullptr;
+    std::size_t   size   = 0;
+    FILE *        out    = open_memstream(&buffer, &size);
+    const bool    parsed = parse_script(text, *store, statements, out);
+    fclose(out);
+    errors.assign(buffer, size);
+    free(buffer);
+    parses.add(std::chrono::steady_clock::now() - start);
+    if (!parsed) {
+        return nullptr;
+    }
+
+    entries.push_front({ text, std::move(statements) });
+    index[hash] = begin(entries);
+    if (entries.size() > options.cache) {
+        index.erase(std::hash<std::string>{}(entries.back().text));
+        entries.pop_back();
+        evictions++;
+    }
+    return &entries.front();
+}
+
+std::string QueryServer::answer(Session &session, const std::string &line)
+{
+    ProfileScope scope("request");
+    const auto   start  = std::chrono::steady_clock::now();
+    char *       buffer = nullptr;
+    std::size_t  size   = 0;
+    FILE *       out    = open_memstream(&buffer, &size);
+
+    const auto text = canonical(line);
+    if (text == "stats") {
+        write_stats(out);
+    } else if (!text.empty()) {
+        std::string errors;
+        if (auto entry = lookup(text, errors)) {
+            if (options.incremental && (!session.ec.incremental || session.generation != generation)) {
+                session.ec.incremental = std::make_shared<IncrementalSolver>(*store);
+                session.generation     = generation;
+            }
+            session.ec.out = out;
+            for (auto stmt : entry->statements.statements) {
+                const auto begun = std::chrono::steady_clock::now();
+                stmt->exec(session.ec);
+                statements[stmt->name()].add(std::chrono::steady_clock::now() - begun);
+            }
+        } else {
+            fprintf(out, "error: %s", errors.empty() ? "syntax error\n" : errors.c_str());
+        }
+    }
+    fprintf(out, "\n");
+    fclose(out);
+
+    std::string response(buffer, size);
+    free(buffer);
+    requests.add(std::chrono::steady_clock::now() - start);
+    return response;
+}
+
+void QueryServer::write_stats(FILE *out) const
+{
+    fprintf(out, "cache %zu of %zu requests, %llu hits, %llu misses, %llu evictions, %llu resets, %zu nodes\n", entries.size(),
+            options.cache, static_cast<unsigned long long>(hits), static_cast<unsigned long long>(misses),
+            static_cast<unsigned long long>(evictions), static_cast<unsigned long long>(resets), store->size());
+    requests.write(out, "request");
+    parses.write(out, "parse");
+    for (const auto &[name, histogram] : statements) {
+        histogram.write(out, name.c_str());
+    }
+}
+
+void QueryServer::serve(FILE *in, FILE *out)
+{
+    Session session(options.ec);
+    char *  line     = nullptr;
+    size_t  capacity = 0;
+    while (getline(&line, &capacity, in) != -1) {
+        const auto response = answer(session, line);
+        fwrite(response.data(), 1, response.size(), out);
+        fflush(out);
+    }
+    free(line);
+}
+
+// Writes all of data unless the client went away
+static bool send_all(int fd, const std::string &data)
+{
+    for (std::size_t sent = 0; sent < data.size();) {
+        const auto n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+bool QueryServer::listen(const char *path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (std::strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return false;
+    }
+    std::strcpy(address.sun_path, path);
+
+    // A socket an earlier server left behind is replaced, any other file at path is kept
+    struct stat existing;
+    if (::lstat(path, &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            fprintf(stderr, "%s: exists and is not a socket\n", path);
+            return false;
+        }
+        ::unlink(path);
+    }
+
+    const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || ::listen(listener, 64) < 0) {
+        perror(path);
+        if (listener >= 0) {
+            ::close(listener);
+        }
+        return false;
+    }
+
+    // Entry 0 is the listener, the sessions belong to the others
+    std::vector<pollfd>                   fds{ { listener, POLLIN, 0 } };
+    std::vector<std::unique_ptr<Session>> sessions(1);
+    for (;;) {
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+
+        for (std::size_t i = fds.size(); i-- > 1;) {
+            if (!fds[i].revents) {
+                continue;
+            }
+            char       chunk[4096];
+            const auto n       = ::recv(fds[i].fd, chunk, sizeof(chunk), 0);
+            bool       open    = n > 0 || (n < 0 && errno == EINTR);
+            auto &     session = *sessions[i];
+            if (n > 0) {
+                session.input.append(chunk, static_cast<std::size_t>(n));
+            }
+            for (std::size_t eol; open && (eol = session.input.find('\n')) != std::string::npos;) {
+                const auto line = session.input.substr(0, eol);
+                session.input.erase(0, eol + 1);
+                open = send_all(fds[i].fd, answer(session, line));
+            }
+            if (!open) {
+                ::close(fds[i].fd);
+                fds.erase(begin(fds) + i);
+                sessions.erase(begin(sessions) + i);
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            const int client = ::accept(listener, nullptr, nullptr);
+            if (client >= 0) {
+                fds.push_back({ client, POLLIN, 0 });
+                sessions.push_back(std::make_unique<Session>(options.ec));
+            }
+        }
+    }
+    ::close(listener);
+    ::unlink(path);
+    return false;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "ast.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Request latencies in power of two buckets of microseconds
+class LatencyHistogram {
+public:
+    void add(std::chrono::steady_clock::duration latency);
+
+    std::uint64_t count() const { return n; }
+    // Upper bound in µs of the bucket holding the p-th fraction of requests
+    std::uint64_t percentile(double p) const;
+
+    // One line: count, p50, p90, p99 and the maximum
+    void write(FILE *out, const char *name) const;
+
+private:
+    std::array<std::uint64_t, 40> buckets{}; // bucket i counts latencies below 2^i µs
+    std::uint64_t                 n   = 0;
+    std::uint64_t                 max = 0; // ns
+};
+
+// Long running mode answering one script line per request, with the same output as
+// satsolver has for that line, followed by an empty line. A line reading "stats" is answered
+// with the cache counters and latency histograms.
+//
+// Parsed requests are kept in an LRU cache keyed by the request with whitespace collapsed.
+// Their statements share one expression store and keep their normal forms and compiled
+// programs, a repeated query neither parses nor normalizes again. The store is started over
+// once it holds more than max_nodes expressions.
+//
+// Every client has its own assignments, requests of one client see the set statements of
+// its earlier ones. The server is single threaded, clients of a socket are multiplexed.
+class QueryServer {
+public:
+    struct Options {
+        std::size_t       cache       = 1024; // requests kept parsed
+        std::size_t       max_nodes   = std::size_t(1) << 22;
+        bool              incremental = false; // every client gets an IncrementalSolver
+        EvaluationContext ec;
+    };
+
+    explicit QueryServer(Options options);
+    ~QueryServer();
+
+    QueryServer(const QueryServer &) = delete;
+    QueryServer &operator=(const QueryServer &) = delete;
+
+    // Answers the requests of in on out until in ends
+    void serve(FILE *in, FILE *out);
+    // Accepts clients on a unix domain socket until the process is killed, false if the
+    // socket could not be set up
+    bool listen(const char *path);
+
+private:
+    struct Session {
+        explicit Session(const EvaluationContext &ec)
+            : ec(ec)
+        {
+        }
+
+        EvaluationContext ec;
+        std::uint64_t     generation = 0; // of the store ec.incremental was made for
+        std::string       input; // received, not yet a complete line
+    };
+
+    struct Entry {
+        std::string   text; // canonical request
+        StatementList statements;
+    };
+
+    std::string answer(Session &session, const std::string &line);
+    Entry *     lookup(const std::string &text, std::string &errors);
+    void        write_stats(FILE *out) const;
+    void        reset();
+
+    Options                                                     options;
+    std::unique_ptr<ExpressionStore>                            store;
+    std::uint64_t                                               generation = 0; // stores started so far
+    std::list<Entry>                                            entries; // most recently used first
+    std::unordered_map<std::size_t, std::list<Entry>::iterator> index; // hash of Entry::text
+    std::uint64_t                                               hits = 0, misses = 0, evictions = 0, resets = 0;
+    LatencyHistogram                                            requests;
+    LatencyHistogram                                            parses;
+    std::map<std::string, LatencyHistogram>                     statements; // by Statement::name()
+};
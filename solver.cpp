@@ -0,0 +1,816 @@
+#include "solver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace sat {
+
+CRef ClauseArena::alloc(const std::vector<Lit> &lits, bool learnt)
+{
+    if (ids) {
+        words.insert(end(words), 2, 0);
+    }
+    const auto c = static_cast<CRef>(words.size());
+    words.push_back(static_cast<std::uint32_t>(lits.size()));
+    words.push_back(learnt ? 1 : 0);
+    words.push_back(0);
+    words.insert(end(words), begin(lits), end(lits));
+    set_activity(c, 0.0f);
+    return c;
+}
+
+float ClauseArena::activity(CRef c) const
+{
+    float act;
+    std::memcpy(&act, &words[c + 2], sizeof(act));
+    return act;
+}
+
+void ClauseArena::set_activity(CRef c, float act) { std::memcpy(&words[c + 2], &act, sizeof(act)); }
+
+// The luby sequence 1 1 2 1 1 2 4 1 1 2 ... used to scale the restart intervals.
+static double luby(double y, std::uint64_t x)
+{
+    std::uint64_t size = 1, seq = 0;
+    for (; size < x + 1; seq++, size = 2 * size + 1)
+        ;
+    while (size - 1 != x) {
+        size = (size - 1) >> 1;
+        seq--;
+        x = x % size;
+    }
+    return std::pow(y, static_cast<double>(seq));
+}
+
+Solver::Solver(Options opts)
+    : opts(opts)
+    , rng(opts.seed * 0x9E3779B97F4A7C15ull + 1)
+{
+}
+
+// xorshift64, only used when opts.seed is set
+std::uint64_t Solver::random()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+std::uint64_t Solver::next_restart() const
+{
+    if (opts.restarts == Restarts::Geometric) {
+        return static_cast<std::uint64_t>(std::pow(opts.restart_inc, static_cast<double>(st.restarts)) * opts.restart_first);
+    }
+    return static_cast<std::uint64_t>(luby(2, st.restarts) * opts.restart_first);
+}
+
+Var Solver::new_var()
+{
+    const auto v = static_cast<Var>(assigns.size());
+    assigns.push_back(Undef);
+    polarity.push_back(!opts.initial_phase); // 1 = negative phase first
+    seen.push_back(0);
+    level.push_back(0);
+    reason.push_back(NoReason);
+    activity.push_back(opts.seed ? (random() % 1024) * 1e-5 : 0.0);
+    heap_index.push_back(-1);
+    lbd_stamp.push_back(0);
+    unit_ids.push_back(0);
+    watches.emplace_back();
+    watches.emplace_back();
+    heap_insert(v);
+    return v;
+}
+
+bool Solver::add_clause(std::vector<Lit> lits)
+{
+    const auto id = ++last_id;
+    if (!ok) {
+        return false;
+    }
+    if (proof) {
+        original = lits;
+    }
+
+    // Drop duplicates and literals false at the root, skip satisfied and tautological clauses.
+    std::sort(begin(lits), end(lits));
+    std::size_t j         = 0;
+    Lit         prev      = UndefLit;
+    bool        shortened = false;
+    for (const auto l : lits) {
+        if (value(l) == True || l == neg(prev)) {
+            return true;
+        }
+        shortened |= value(l) == False;
+        if (value(l) != False && l != prev) {
+            lits[j++] = prev = l;
+        }
+    }
+    lits.resize(j);
+
+    // Without its false literals the clause is a new one, derived from the root units
+    auto kept = id;
+    if (proof && (shortened || lits.empty())) {
+        kept = derive(lits.data(), lits.size(), original.data(), static_cast<std::uint32_t>(original.size()), id);
+        proof->remove(id, original.data(), original.size());
+    }
+
+    if (lits.empty()) {
+        return ok = false;
+    }
+    if (lits.size() == 1) {
+        enqueue(lits[0], NoReason);
+        if (proof) {
+            unit_ids[var(lits[0])] = kept;
+        }
+        const auto confl = propagate();
+        if (confl != NoReason && proof) {
+            refute(confl);
+        }
+        return ok = (confl == NoReason);
+    }
+
+    const auto c = ca.alloc(lits, false);
+    clauses.push_back(c);
+    attach(c);
+    if (proof) {
+        ca.set_id(c, kept);
+    }
+    return true;
+}
+
+void Solver::attach(CRef c)
+{
+    const auto *l = ca.lits(c);
+    watches[neg(l[0])].push_back({ c, l[1] });
+    watches[neg(l[1])].push_back({ c, l[0] });
+}
+
+void Solver::enqueue(Lit l, CRef from)
+{
+    const auto v = var(l);
+    assigns[v]   = static_cast<std::uint8_t>(!sign(l));
+    level[v]     = decision_level();
+    reason[v]    = from;
+    trail.push_back(l);
+}
+
+CRef Solver::propagate()
+{
+    CRef confl = NoReason;
+
+    while (qhead < trail.size()) {
+        const Lit  p        = trail[qhead++];
+        const Lit  falselit = neg(p);
+        auto &     ws       = watches[p];
+        std::size_t i = 0, j = 0;
+        const auto n = ws.size();
+        st.propagations++;
+
+        while (i < n) {
+            const auto w = ws[i];
+            if (value(w.blocker) == True) {
+                ws[j++] = ws[i++];
+                continue;
+            }
+
+            auto *     c    = ca.lits(w.cref);
+            const auto size = ca.size(w.cref);
+            if (c[0] == falselit) {
+                std::swap(c[0], c[1]);
+            }
+            i++;
+
+            const Lit     first = c[0];
+            const Watcher nw{ w.cref, first };
+            if (first != w.blocker && value(first) == True) {
+                ws[j++] = nw;
+                continue;
+            }
+
+            bool moved = false;
+            for (std::uint32_t k = 2; k < size; k++) {
+                if (value(c[k]) != False) {
+                    c[1] = c[k];
+                    c[k] = falselit;
+                    watches[neg(c[1])].push_back(nw);
+                    moved = true;
+                    break;
+                }
+            }
+            if (moved) {
+                continue;
+            }
+
+            ws[j++] = nw;
+            if (value(first) == False) {
+                confl = w.cref;
+                qhead = trail.size();
+                while (i < n) {
+                    ws[j++] = ws[i++];
+                }
+            } else {
+                enqueue(first, w.cref);
+            }
+        }
+        ws.resize(j);
+    }
+
+    return confl;
+}
+
+static std::uint32_t abstract_level(int level) { return 1u << (level & 31); }
+
+void Solver::analyze(CRef confl, std::vector<Lit> &out, int &btlevel, std::uint32_t &lbd)
+{
+    int  pathc = 0;
+    Lit  p     = UndefLit;
+    auto index = trail.size();
+
+    out.clear();
+    out.push_back(UndefLit); // room for the asserting literal
+
+    do {
+        if (ca.learnt(confl)) {
+            bump_clause(confl);
+        }
+
+        const auto *c    = ca.lits(confl);
+        const auto  size = ca.size(confl);
+        for (std::uint32_t k = (p == UndefLit ? 0 : 1); k < size; k++) {
+            const Lit q = c[k];
+            const Var v = var(q);
+            if (!seen[v] && level[v] > 0) {
+                bump_var(v);
+                seen[v] = 1;
+                if (level[v] >= decision_level()) {
+                    pathc++;
+                } else {
+                    out.push_back(q);
+                }
+            }
+        }
+
+        while (!seen[var(trail[--index])])
+            ;
+        p       = trail[index];
+        confl   = reason[var(p)];
+        seen[var(p)] = 0;
+        pathc--;
+    } while (pathc > 0);
+    out[0] = neg(p);
+
+    // Recursive minimization: drop literals implied by the rest of the clause.
+    analyze_clear.assign(begin(out), end(out));
+    std::uint32_t levels = 0;
+    for (std::size_t k = 1; k < out.size(); k++) {
+        levels |= abstract_level(level[var(out[k])]);
+    }
+    std::size_t j = 1;
+    for (std::size_t k = 1; k < out.size(); k++) {
+        if (reason[var(out[k])] == NoReason || !redundant(out[k], levels)) {
+            out[j++] = out[k];
+        }
+    }
+    out.resize(j);
+
+    // Put the literal of the highest remaining level at index 1, it becomes the second watch.
+    btlevel = 0;
+    if (out.size() > 1) {
+        std::size_t maxi = 1;
+        for (std::size_t k = 2; k < out.size(); k++) {
+            if (level[var(out[k])] > level[var(out[maxi])]) {
+                maxi = k;
+            }
+        }
+        std::swap(out[1], out[maxi]);
+        btlevel = level[var(out[1])];
+    }
+
+    lbd_counter++;
+    lbd = 0;
+    for (const auto l : out) {
+        const auto lv = static_cast<std::size_t>(level[var(l)]);
+        if (lbd_stamp[lv] != lbd_counter) {
+            lbd_stamp[lv] = lbd_counter;
+            lbd++;
+        }
+    }
+
+    for (const auto l : analyze_clear) {
+        seen[var(l)] = 0;
+    }
+}
+
+// p is an assumption found false, collects the assumptions that imply ¬p into core
+void Solver::analyze_final(Lit p)
+{
+    core.clear();
+    core.push_back(p);
+    if (decision_level() == 0) {
+        return;
+    }
+
+    seen[var(p)] = 1;
+    for (auto k = trail.size(); k-- > trail_lim[0];) {
+        const Var v = var(trail[k]);
+        if (!seen[v]) {
+            continue;
+        }
+        if (reason[v] == NoReason) {
+            core.push_back(trail[k]); // decisions below the assumption levels are assumptions
+        } else {
+            const auto *c    = ca.lits(reason[v]);
+            const auto  size = ca.size(reason[v]);
+            for (std::uint32_t j = 1; j < size; j++) {
+                if (level[var(c[j])] > 0) {
+                    seen[var(c[j])] = 1;
+                }
+            }
+        }
+        seen[v] = 0;
+    }
+    seen[var(p)] = 0;
+}
+
+bool Solver::redundant(Lit l, std::uint32_t levels)
+{
+    analyze_stack.clear();
+    analyze_stack.push_back(l);
+    const auto top = analyze_clear.size();
+
+    while (!analyze_stack.empty()) {
+        const auto  r    = reason[var(analyze_stack.back())];
+        const auto *c    = ca.lits(r);
+        const auto  size = ca.size(r);
+        analyze_stack.pop_back();
+
+        for (std::uint32_t k = 1; k < size; k++) {
+            const Lit q = c[k];
+            const Var v = var(q);
+            if (seen[v] || level[v] == 0) {
+                continue;
+            }
+            if (reason[v] != NoReason && (abstract_level(level[v]) & levels)) {
+                seen[v] = 1;
+                analyze_stack.push_back(q);
+                analyze_clear.push_back(q);
+            } else {
+                for (auto k2 = top; k2 < analyze_clear.size(); k2++) {
+                    seen[var(analyze_clear[k2])] = 0;
+                }
+                analyze_clear.resize(top);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void Solver::backtrack(int lvl)
+{
+    if (decision_level() <= lvl) {
+        return;
+    }
+    for (auto k = trail.size(); k-- > trail_lim[lvl];) {
+        const Var v = var(trail[k]);
+        assigns[v] = Undef;
+        if (opts.phase_saving) {
+            polarity[v] = sign(trail[k]);
+        }
+        if (heap_index[v] < 0) {
+            heap_insert(v);
+        }
+    }
+    trail.resize(trail_lim[lvl]);
+    trail_lim.resize(lvl);
+    qhead = trail.size();
+}
+
+Lit Solver::pick_branch()
+{
+    if (opts.random_freq > 0 && !heap.empty() && random() % 1000000 < opts.random_freq * 1000000) {
+        const Var v = heap[random() % heap.size()];
+        if (assigns[v] == Undef) {
+            return mklit(v, polarity[v]);
+        }
+    }
+    while (!heap.empty()) {
+        const Var v = heap_pop();
+        if (assigns[v] == Undef) {
+            return mklit(v, polarity[v]);
+        }
+    }
+    return UndefLit;
+}
+
+void Solver::bump_var(Var v)
+{
+    if ((activity[v] += var_inc) > 1e100) {
+        for (auto &a : activity) {
+            a *= 1e-100;
+        }
+        var_inc *= 1e-100;
+    }
+    if (heap_index[v] >= 0) {
+        heap_up(static_cast<std::uint32_t>(heap_index[v]));
+    }
+}
+
+void Solver::bump_clause(CRef c)
+{
+    const auto act = ca.activity(c) + static_cast<float>(clause_inc);
+    ca.set_activity(c, act);
+    if (act > 1e20f) {
+        for (const auto l : learnts) {
+            ca.set_activity(l, ca.activity(l) * 1e-20f);
+        }
+        clause_inc *= 1e-20;
+    }
+}
+
+std::uint64_t Solver::derive(const Lit *lits, std::size_t size, const Lit *confl, std::uint32_t confl_size, std::uint64_t confl_id)
+{
+    hints.clear();
+    if (proof->hints()) {
+        // Walks back from the conflict through the reasons and stops at the literals of the
+        // new clause. In post order every reason comes after the reasons of its other
+        // literals, the order unit propagation uses them in. Root variables get a unit clause
+        // the first time they are needed, their support does not go into the hints.
+        for (std::size_t i = 0; i < size; i++) {
+            seen[var(lits[i])] = 2;
+            proof_clear.push_back(var(lits[i]));
+        }
+        const auto pre = [&](Antecedent &a, const auto &push) {
+            const Var v = a.var;
+            if (seen[v]) {
+                if (seen[v] == 1 && !a.support && level[v] == 0) {
+                    hints.push_back(unit_ids[v]); // so far only the support of another root variable
+                    seen[v] = 2;
+                }
+                return false;
+            }
+            seen[v] = a.support ? 1 : 2;
+            proof_clear.push_back(v);
+            if (level[v] == 0 && unit_ids[v]) {
+                return true;
+            } else if (reason[v] == NoReason) {
+                return false; // a decision, the new clause is not derived from this conflict
+            }
+            const auto *c = ca.lits(reason[v]);
+            for (std::uint32_t k = 0; k < ca.size(reason[v]); k++) {
+                if (var(c[k]) != v) {
+                    push({ var(c[k]), level[v] == 0 });
+                }
+            }
+            return true;
+        };
+        const auto post = [&](const Antecedent &a) {
+            const Var v = a.var;
+            if (level[v] > 0) {
+                hints.push_back(ca.id(reason[v]));
+                return;
+            }
+            if (!unit_ids[v]) {
+                unit_hints.clear();
+                const auto *c = ca.lits(reason[v]);
+                for (std::uint32_t k = 0; k < ca.size(reason[v]); k++) {
+                    if (var(c[k]) != v) {
+                        unit_hints.push_back(unit_ids[var(c[k])]);
+                    }
+                }
+                unit_hints.push_back(ca.id(reason[v]));
+                const Lit unit = mklit(v, assigns[v] == False);
+                unit_ids[v]    = ++derived;
+                proof->add(derived, &unit, 1, unit_hints);
+            }
+            if (!a.support) {
+                hints.push_back(unit_ids[v]);
+            }
+        };
+        for (std::uint32_t k = 0; k < confl_size; k++) {
+            walk.run({ var(confl[k]), false }, pre, post);
+        }
+        hints.push_back(confl_id);
+
+        for (const auto v : proof_clear) {
+            seen[v] = 0;
+        }
+        proof_clear.clear();
+    }
+
+    proof->add(++derived, lits, size, hints);
+    return derived;
+}
+
+void Solver::refute(CRef confl) { derive(nullptr, 0, ca.lits(confl), ca.size(confl), ca.id(confl)); }
+
+void Solver::forget(CRef c)
+{
+    proof->remove(ca.id(c), ca.lits(c), ca.size(c));
+}
+
+bool Solver::locked(CRef c) const
+{
+    const Lit first = ca.lits(c)[0];
+    return value(first) == True && reason[var(first)] == c;
+}
+
+void Solver::reduce_db()
+{
+    // Keep glue clauses, throw away the less useful half of the rest.
+    std::sort(begin(learnts), end(learnts), [this](CRef a, CRef b) {
+        if (ca.lbd(a) != ca.lbd(b)) {
+            return ca.lbd(a) > ca.lbd(b);
+        }
+        return ca.activity(a) < ca.activity(b);
+    });
+
+    const auto  half = learnts.size() / 2;
+    std::size_t j    = 0;
+    for (std::size_t k = 0; k < learnts.size(); k++) {
+        const auto c = learnts[k];
+        if (k < half && ca.lbd(c) > 2 && !locked(c)) {
+            if (proof) {
+                forget(c);
+            }
+            ca.set_deleted(c);
+            st.deleted++;
+        } else {
+            learnts[j++] = c;
+        }
+    }
+    learnts.resize(j);
+
+    for (auto &ws : watches) {
+        ws.erase(std::remove_if(begin(ws), end(ws), [this](const Watcher &w) { return ca.deleted(w.cref); }), end(ws));
+    }
+
+    if (ca.wasted > ca.used() / 5) {
+        collect_garbage();
+    }
+}
+
+void Solver::collect_garbage()
+{
+    ClauseArena to;
+    to.ids = ca.ids;
+    to.words.reserve(ca.used() - ca.wasted);
+
+    auto move = [&](CRef c) {
+        const auto  size = ca.size(c);
+        const auto *l    = ca.lits(c);
+        const auto  n    = to.alloc(std::vector<Lit>(l, l + size), ca.learnt(c));
+        to.set_lbd(n, ca.lbd(c));
+        to.set_activity(n, ca.activity(c));
+        if (ca.ids) {
+            to.set_id(n, ca.id(c));
+        }
+        return n;
+    };
+
+    // Forwarding table from old to new offsets, every live clause is moved exactly once.
+    std::vector<CRef> forward(ca.used(), NoReason);
+    for (auto *list : { &clauses, &learnts }) {
+        for (auto &c : *list) {
+            forward[c] = move(c);
+            c          = forward[c];
+        }
+    }
+    for (auto &ws : watches) {
+        for (auto &w : ws) {
+            w.cref = forward[w.cref];
+        }
+    }
+    for (const auto l : trail) {
+        auto &r = reason[var(l)];
+        if (r != NoReason) {
+            r = forward[r];
+        }
+    }
+
+    ca = std::move(to);
+}
+
+bool Solver::import_clauses()
+{
+    while (sharing->import_clause(imported)) {
+        // At the root: drop false literals, skip satisfied clauses
+        bool        satisfied = false;
+        std::size_t j         = 0;
+        for (const auto l : imported) {
+            satisfied |= value(l) == True;
+            if (value(l) == Undef) {
+                imported[j++] = l;
+            }
+        }
+        imported.resize(j);
+        if (satisfied) {
+            continue;
+        }
+
+        if (imported.empty()) {
+            return false;
+        }
+        if (imported.size() == 1) {
+            enqueue(imported[0], NoReason);
+            if (propagate() != NoReason) {
+                return false;
+            }
+            continue;
+        }
+
+        const auto c = ca.alloc(imported, true);
+        ca.set_lbd(c, static_cast<std::uint32_t>(imported.size()));
+        learnts.push_back(c);
+        attach(c);
+    }
+    return true;
+}
+
+void Solver::heap_insert(Var v)
+{
+    heap_index[v] = static_cast<std::int32_t>(heap.size());
+    heap.push_back(v);
+    heap_up(static_cast<std::uint32_t>(heap.size() - 1));
+}
+
+void Solver::heap_up(std::uint32_t i)
+{
+    const Var v = heap[i];
+    while (i > 0) {
+        const auto parent = (i - 1) >> 1;
+        if (activity[heap[parent]] >= activity[v]) {
+            break;
+        }
+        heap[i]             = heap[parent];
+        heap_index[heap[i]] = static_cast<std::int32_t>(i);
+        i                   = parent;
+    }
+    heap[i]       = v;
+    heap_index[v] = static_cast<std::int32_t>(i);
+}
+
+void Solver::heap_down(std::uint32_t i)
+{
+    const Var  v = heap[i];
+    const auto n = static_cast<std::uint32_t>(heap.size());
+    for (;;) {
+        auto child = 2 * i + 1;
+        if (child >= n) {
+            break;
+        }
+        if (child + 1 < n && activity[heap[child + 1]] > activity[heap[child]]) {
+            child++;
+        }
+        if (activity[heap[child]] <= activity[v]) {
+            break;
+        }
+        heap[i]             = heap[child];
+        heap_index[heap[i]] = static_cast<std::int32_t>(i);
+        i                   = child;
+    }
+    heap[i]       = v;
+    heap_index[v] = static_cast<std::int32_t>(i);
+}
+
+Var Solver::heap_pop()
+{
+    const Var top   = heap.front();
+    heap_index[top] = -1;
+    heap.front()    = heap.back();
+    heap.pop_back();
+    if (!heap.empty()) {
+        heap_index[heap.front()] = 0;
+        heap_down(0);
+    }
+    return top;
+}
+
+Result Solver::solve(const std::vector<Lit> &assumptions)
+{
+    model.clear();
+    core.clear();
+    if (!ok) {
+        return Result::Unsat;
+    }
+    if (const auto confl = propagate(); confl != NoReason) {
+        if (proof) {
+            refute(confl);
+        }
+        ok = false;
+        return Result::Unsat;
+    }
+    if (sharing && !import_clauses()) {
+        ok = false;
+        return Result::Unsat;
+    }
+
+    std::vector<Lit> learnt;
+    std::uint64_t    restart_limit = next_restart();
+    std::uint64_t    since_restart = 0;
+    std::uint64_t    next_reduce   = st.conflicts + opts.reduce_first;
+    std::uint64_t    reduce_step   = opts.reduce_first;
+
+    for (;;) {
+        const auto confl = propagate();
+        if (confl != NoReason) {
+            st.conflicts++;
+            since_restart++;
+            if (decision_level() == 0) {
+                if (proof) {
+                    refute(confl);
+                }
+                ok = false;
+                return Result::Unsat;
+            }
+
+            int           btlevel;
+            std::uint32_t lbd;
+            analyze(confl, learnt, btlevel, lbd);
+            const auto id = proof ? derive(learnt.data(), learnt.size(), ca.lits(confl), ca.size(confl), ca.id(confl)) : 0;
+            backtrack(btlevel);
+
+            if (learnt.size() == 1) {
+                enqueue(learnt[0], NoReason);
+                if (proof) {
+                    unit_ids[var(learnt[0])] = id;
+                }
+            } else {
+                const auto c = ca.alloc(learnt, true);
+                ca.set_lbd(c, lbd);
+                learnts.push_back(c);
+                attach(c);
+                if (proof) {
+                    ca.set_id(c, id);
+                }
+                bump_clause(c);
+                enqueue(learnt[0], c);
+            }
+            st.learnts++;
+            if (sharing && learnt.size() <= shared_size) {
+                sharing->export_clause(learnt);
+            }
+
+            var_inc /= opts.var_decay;
+            clause_inc /= opts.clause_decay;
+
+            if ((opts.conflict_budget && st.conflicts >= opts.conflict_budget) || (sharing && sharing->stopped())) {
+                backtrack(0);
+                return Result::Unknown;
+            }
+            continue;
+        }
+
+        if (since_restart >= restart_limit) {
+            st.restarts++;
+            since_restart = 0;
+            restart_limit = next_restart();
+            backtrack(0);
+            if (sharing && !import_clauses()) {
+                ok = false;
+                return Result::Unsat;
+            }
+        }
+
+        if (st.conflicts >= next_reduce) {
+            reduce_step += opts.reduce_inc;
+            next_reduce = st.conflicts + reduce_step;
+            reduce_db();
+        }
+
+        // The first decision levels belong to the assumptions, one each
+        Lit next = UndefLit;
+        while (decision_level() < static_cast<int>(assumptions.size())) {
+            const Lit p = assumptions[decision_level()];
+            if (value(p) == True) {
+                trail_lim.push_back(trail.size());
+            } else if (value(p) == False) {
+                analyze_final(p);
+                backtrack(0);
+                return Result::Unsat;
+            } else {
+                next = p;
+                break;
+            }
+        }
+        if (next == UndefLit) {
+            next = pick_branch();
+        }
+        if (next == UndefLit) {
+            model.resize(num_vars());
+            for (Var v = 0; v < num_vars(); v++) {
+                model[v] = assigns[v] == True;
+            }
+            backtrack(0);
+            return Result::Sat;
+        }
+
+        st.decisions++;
+        trail_lim.push_back(trail.size());
+        enqueue(next, NoReason);
+    }
+}
+}
@@ -0,0 +1,252 @@
+#pragma once
+#include "traversal.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace sat {
+
+using Var  = std::uint32_t;
+using Lit  = std::uint32_t;
+using CRef = std::uint32_t;
+
+// Literals are encoded as 2 * var + sign, so ~l is l ^ 1 and they index watch lists directly.
+constexpr Lit  mklit(Var v, bool negated = false) { return (v << 1) | static_cast<Lit>(negated); }
+constexpr Lit  neg(Lit l) { return l ^ 1; }
+constexpr Var  var(Lit l) { return l >> 1; }
+constexpr bool sign(Lit l) { return l & 1; }
+
+constexpr Lit  UndefLit = UINT32_MAX;
+constexpr CRef NoReason = UINT32_MAX;
+
+enum class Result { Sat, Unsat, Unknown };
+
+enum class Restarts { Luby, Geometric };
+
+struct Options {
+    double        var_decay       = 0.95;
+    double        clause_decay    = 0.999;
+    Restarts      restarts        = Restarts::Luby;
+    std::uint64_t restart_first   = 100; // luby unit resp. first interval in conflicts
+    double        restart_inc     = 1.5; // growth of geometric restart intervals
+    std::uint64_t reduce_first    = 2000;
+    std::uint64_t reduce_inc      = 300;
+    std::uint64_t conflict_budget = 0; // 0 = unlimited
+    bool          phase_saving    = true;
+    bool          initial_phase   = false; // polarity of the first decision on a variable
+    std::uint64_t seed            = 0; // 0 = deterministic, otherwise random initial order and random_freq decisions
+    double        random_freq     = 0.0;
+};
+
+struct Stats {
+    std::uint64_t decisions    = 0;
+    std::uint64_t propagations = 0;
+    std::uint64_t conflicts    = 0;
+    std::uint64_t restarts     = 0;
+    std::uint64_t learnts      = 0;
+    std::uint64_t deleted      = 0;
+};
+
+// Connects a solver to others working on the same variables and clauses. Solvers export
+// their short learnt clauses, import the clauses of the others at restarts and give up
+// with Result::Unknown once stopped() is set.
+class ClauseSharing {
+public:
+    virtual ~ClauseSharing() = default;
+
+    virtual void export_clause(const std::vector<Lit> &lits) = 0;
+    // Fills lits with the next clause of another solver, false if there is none
+    virtual bool import_clause(std::vector<Lit> &lits) = 0;
+    virtual bool stopped() const                       = 0;
+};
+
+// Receives the clauses a solver derives and deletes, which make up a proof once it derived
+// the empty clause (see proof.h). The original clauses are numbered 1, 2, ... in the order
+// of the add_clause() calls, whether the solver kept them or not, the derived ones after
+// them.
+class ProofSink {
+public:
+    virtual ~ProofSink() = default;
+
+    // Whether add() wants hints: the clauses that, in this order, become unit and then
+    // conflict once every literal of the new clause is false
+    virtual bool hints() const = 0;
+    virtual void add(std::uint64_t id, const Lit *lits, std::size_t size, const std::vector<std::uint64_t> &hints) = 0;
+    virtual void remove(std::uint64_t id, const Lit *lits, std::size_t size) = 0;
+};
+
+// Clause storage: one contiguous word array, each clause is a three word header
+// (size, flags|lbd, activity) followed by its literals. CRefs are offsets into it.
+// For proofs every clause is preceded by two more words, its 64 bit id.
+class ClauseArena {
+public:
+    CRef alloc(const std::vector<Lit> &lits, bool learnt);
+
+    std::uint64_t id(CRef c) const { return words[c - 2] | static_cast<std::uint64_t>(words[c - 1]) << 32; }
+    void          set_id(CRef c, std::uint64_t id)
+    {
+        words[c - 2] = static_cast<std::uint32_t>(id);
+        words[c - 1] = static_cast<std::uint32_t>(id >> 32);
+    }
+
+    std::uint32_t size(CRef c) const { return words[c]; }
+    Lit *         lits(CRef c) { return &words[c + 3]; }
+    const Lit *   lits(CRef c) const { return &words[c + 3]; }
+
+    bool learnt(CRef c) const { return words[c + 1] & 1; }
+    bool deleted(CRef c) const { return words[c + 1] & 2; }
+    void set_deleted(CRef c)
+    {
+        words[c + 1] |= 2;
+        wasted += 3 + size(c) + (ids ? 2 : 0);
+    }
+
+    std::uint32_t lbd(CRef c) const { return words[c + 1] >> 2; }
+    void          set_lbd(CRef c, std::uint32_t lbd) { words[c + 1] = (words[c + 1] & 3) | (lbd << 2); }
+
+    float activity(CRef c) const;
+    void  set_activity(CRef c, float act);
+
+    std::size_t used() const { return words.size(); }
+    std::size_t wasted = 0;
+    bool        ids    = false;
+
+    std::vector<std::uint32_t> words;
+};
+
+class Solver {
+public:
+    explicit Solver(Options opts = {});
+
+    Var         new_var();
+    std::size_t num_vars() const { return assigns.size(); }
+
+    // Returns false if the clause set became trivially unsatisfiable.
+    bool add_clause(std::vector<Lit> lits);
+
+    Result solve() { return solve({}); }
+
+    // Solves with the assumption literals fixed. The solver stays usable afterwards, clauses
+    // and variables may be added and learnt clauses are kept for the next call.
+    Result solve(const std::vector<Lit> &assumptions);
+
+    // Only meaningful after solve() returned Result::Sat.
+    bool model_value(Var v) const { return model[v]; }
+
+    // After solve() returned Result::Unsat: the assumptions that already contradict the
+    // clauses, empty if the clauses are unsatisfiable on their own.
+    const std::vector<Lit> &failed() const { return core; }
+
+    const Stats &stats() const { return st; }
+
+    // Learnt clauses with at most max_size literals are exported, sharing is not owned
+    void share(ClauseSharing *sharing, std::size_t max_size = 8)
+    {
+        this->sharing     = sharing;
+        this->shared_size = max_size;
+    }
+
+    // Logs the derived and deleted clauses to proof, which is not owned. Set it before the
+    // first of the original clauses is added, derived clauses are numbered after them.
+    // Imported clauses are not justified, neither are results under assumptions.
+    void prove(ProofSink *proof, std::uint64_t originals)
+    {
+        this->proof = proof;
+        derived     = originals;
+        ca.ids      = proof != nullptr;
+    }
+
+private:
+    enum Value : std::uint8_t { False = 0, True = 1, Undef = 2 };
+
+    struct Watcher {
+        CRef cref;
+        Lit  blocker;
+    };
+
+    // A variable derive() passes on its way back from a conflict. A support is a root
+    // variable another root variable needs for its unit clause.
+    struct Antecedent {
+        Var  var;
+        bool support;
+    };
+
+    Value value(Lit l) const
+    {
+        const auto v = assigns[var(l)];
+        return v == Undef ? Undef : static_cast<Value>(v ^ sign(l));
+    }
+    int  decision_level() const { return static_cast<int>(trail_lim.size()); }
+    void enqueue(Lit l, CRef reason);
+    void attach(CRef c);
+    CRef propagate();
+    void analyze(CRef confl, std::vector<Lit> &learnt, int &btlevel, std::uint32_t &lbd);
+    void analyze_final(Lit p);
+    bool redundant(Lit l, std::uint32_t abstract_levels);
+    void backtrack(int level);
+    Lit  pick_branch();
+    void reduce_db();
+    void collect_garbage();
+
+    bool          import_clauses();
+    std::uint64_t next_restart() const;
+    std::uint64_t random();
+    bool locked(CRef c) const;
+
+    // Proof steps: the clause lits follows from the conflicting clause confl by resolution on
+    // the reasons of the trail, the root literals included
+    std::uint64_t derive(const Lit *lits, std::size_t size, const Lit *confl, std::uint32_t confl_size, std::uint64_t confl_id);
+    void          refute(CRef confl); // derives the empty clause from a conflict at the root
+    void          forget(CRef c);
+
+    void bump_var(Var v);
+    void bump_clause(CRef c);
+
+    // Binary max-heap over variable activity for the decision order.
+    void heap_insert(Var v);
+    void heap_up(std::uint32_t i);
+    void heap_down(std::uint32_t i);
+    Var  heap_pop();
+
+    Options opts;
+    Stats   st;
+    bool    ok = true;
+
+    ClauseArena                       ca;
+    std::vector<CRef>                 clauses, learnts;
+    std::vector<std::vector<Watcher>> watches;
+
+    std::vector<std::uint8_t> assigns, polarity, seen;
+    std::vector<int>          level;
+    std::vector<CRef>         reason;
+    std::vector<Lit>          trail;
+    std::vector<std::size_t>  trail_lim;
+    std::size_t               qhead = 0;
+
+    std::vector<double>        activity;
+    double                     var_inc    = 1.0;
+    double                     clause_inc = 1.0;
+    std::vector<Var>           heap;
+    std::vector<std::int32_t>  heap_index;
+    std::vector<Lit>           analyze_stack, analyze_clear;
+    std::vector<std::uint32_t> lbd_stamp;
+    std::uint32_t              lbd_counter = 0;
+
+    std::vector<bool> model;
+    std::vector<Lit>  core;
+
+    ClauseSharing *  sharing     = nullptr;
+    std::size_t      shared_size = 0;
+    std::vector<Lit> imported;
+    std::uint64_t    rng;
+
+    ProofSink *                proof   = nullptr;
+    std::uint64_t              last_id = 0; // of the latest original clause, with or without a proof
+    std::uint64_t              derived = 0; // id of the latest derived clause
+    std::vector<std::uint64_t> unit_ids; // per variable assigned at the root, the unit clause for it or 0
+    std::vector<std::uint64_t> hints, unit_hints;
+    std::vector<Lit>           original; // add_clause() input, as the proof knows it
+    std::vector<Var>           proof_clear;
+    Traversal<Antecedent>      walk;
+};
+}
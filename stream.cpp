@@ -0,0 +1,72 @@
+#include "stream.h"
+
+#include <algorithm>
+#include <cstdio>
+
+StatementStream::StatementStream(EvaluationContext ec, std::size_t lookahead)
+    : ec(std::move(ec))
+    , lookahead(std::max<std::size_t>(lookahead, 1))
+    , parsing(mutex)
+    , worker([this] { work(); })
+{
+}
+
+StatementStream::~StatementStream()
+{
+    finish();
+}
+
+void StatementStream::push(Statement *stmt)
+{
+    // Waiting releases the store, the worker needs it to make room
+    changed.wait(parsing, [this] { return queue.size() < lookahead; });
+    queue.push_back(stmt);
+    changed.notify_all();
+}
+
+// An idle worker does not need the store, handing it over for every token would cost more
+// than scanning it
+void StatementStream::scanning(bool waiting)
+{
+    if (waiting && !queue.empty()) {
+        parsing.unlock();
+    } else if (!waiting && !parsing.owns_lock()) {
+        parsing.lock();
+    }
+}
+
+void StatementStream::finish()
+{
+    if (!worker.joinable()) {
+        return;
+    }
+    if (!parsing.owns_lock()) {
+        parsing.lock();
+    }
+    done = true;
+    changed.notify_all();
+    parsing.unlock();
+    worker.join();
+    fprintf(ec.out, "\n");
+}
+
+void StatementStream::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        changed.wait(lock, [this] { return done || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+        auto stmt = queue.front();
+        queue.pop_front();
+        changed.notify_all();
+
+        stmt->exec(ec);
+        delete stmt;
+        // Nothing to do until the parser catches up, which may wait for input
+        if (queue.empty()) {
+            fflush(ec.out);
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "ast.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Runs statements on a worker thread as the parser hands them over and frees each one
+// afterwards, so output starts before the end of the input and memory does not grow with
+// the number of statements. Up to lookahead parsed statements wait for their turn, after
+// that the parser blocks.
+//
+// Parser and worker share the expression store. The thread that creates the stream holds
+// the store while it parses and only lets go of it while the scanner reads with statements
+// queued or while the queue is full, the worker holds it while it runs statements. Create,
+// feed and finish the stream from the parsing thread.
+//
+// So only scanning overlaps with running statements. Every reduction of the parser adds
+// nodes to the store, and statements read and add nodes all the time, which the store does
+// not allow concurrently, so parsing the next statement waits for the running one. Reading
+// the input is where a script piped in spends its time, that part does overlap.
+class StatementStream : public StatementSink {
+public:
+    explicit StatementStream(EvaluationContext ec, std::size_t lookahead = 16);
+    ~StatementStream() override;
+
+    StatementStream(const StatementStream &) = delete;
+    StatementStream &operator=(const StatementStream &) = delete;
+
+    void push(Statement *stmt) override;
+    void scanning(bool waiting) override;
+
+    // Runs what is still queued and stops the worker
+    void finish();
+
+private:
+    void work();
+
+    EvaluationContext            ec;
+    std::size_t                  lookahead;
+    std::mutex                   mutex; // the store and everything below
+    std::unique_lock<std::mutex> parsing; // held by the parser outside of the scanner
+    std::condition_variable      changed;
+    std::deque<Statement *>      queue;
+    bool                         done = false;
+    std::thread                  worker;
+};
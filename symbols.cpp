@@ -0,0 +1,42 @@
+#include "symbols.h"
+
+#include <mutex>
+
+static thread_local SymbolTable *scoped = nullptr;
+
+SymbolTable &SymbolTable::global()
+{
+    if (scoped) {
+        return *scoped;
+    }
+    static SymbolTable table;
+    return table;
+}
+
+SymbolTable::Scope::Scope(SymbolTable &table)
+    : previous(scoped)
+{
+    scoped = &table;
+}
+
+SymbolTable::Scope::~Scope()
+{
+    scoped = previous;
+}
+
+AtomId SymbolTable::intern(const std::string &name)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (const auto it = ids.find(name); it != end(ids)) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    const auto [it, inserted] = ids.try_emplace(name, static_cast<AtomId>(names.size()));
+    if (inserted) {
+        names.push_back(name);
+    }
+    return it->second;
+}
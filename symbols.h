@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+using AtomId = std::uint32_t;
+
+// Process wide interner mapping atom names to dense ids. The lexer interns every predicate,
+// everything after it only compares and indexes ids.
+//
+// Ids follow the order names are first seen in, and atoms are listed in the order of their
+// ids. A batch job installs a table of its own with a Scope so that its output does not
+// depend on the scripts that ran before it.
+class SymbolTable {
+public:
+    // Table of the calling thread, the process wide one unless a Scope replaced it
+    static SymbolTable &global();
+
+    // Makes table the one of the calling thread while it lives
+    class Scope {
+    public:
+        explicit Scope(SymbolTable &table);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        SymbolTable *previous;
+    };
+
+    AtomId intern(const std::string &name);
+
+    // The reference stays valid, interned names are never moved
+    const std::string &name(AtomId atom) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return names[atom];
+    }
+
+    std::size_t size() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return names.size();
+    }
+
+private:
+    mutable std::shared_mutex               mutex;
+    std::deque<std::string>                 names;
+    std::unordered_map<std::string, AtomId> ids;
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads executing submitted tasks in fifo order. Tasks must not
+// block on other tasks of the same pool.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(threads.size()); }
+
+    template<typename F>
+    auto submit(F &&f) -> std::future<decltype(f())>
+    {
+        auto task   = std::make_shared<std::packaged_task<decltype(f())()>>(std::forward<F>(f));
+        auto result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.emplace_back([task] { (*task)(); });
+        }
+        wakeup.notify_one();
+        return result;
+    }
+
+    // Process wide pool with one thread per hardware thread
+    static ThreadPool &shared();
+
+private:
+    void work();
+
+    std::vector<std::thread>          threads;
+    std::deque<std::function<void()>> queue;
+    std::mutex                        mutex;
+    std::condition_variable           wakeup;
+    bool                              stop = false;
+};
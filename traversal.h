@@ -0,0 +1,46 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Depth first traversal with an explicit stack, expressions can be far deeper than the call
+// stack allows.
+//
+// pre(item, push) runs when an item is reached and may push the items it depends on, which
+// are then traversed one after the other in the order they were pushed. post(item) runs
+// once all of them are done, unless pre returned false. Items are small values, an ExprId
+// or an ExprId with some state, changes pre makes to its item are seen by post.
+//
+// The stack is kept between runs, reusing a Traversal does not allocate.
+template<typename Item>
+class Traversal {
+public:
+    template<typename Pre, typename Post>
+    void run(Item root, Pre &&pre, Post &&post)
+    {
+        const auto push = [this](const Item &item) { stack.push_back({ item, Reached }); };
+
+        stack.push_back({ root, Reached });
+        while (!stack.empty()) {
+            const auto top = stack.size() - 1;
+            if (stack[top].second != Reached) {
+                if (stack[top].second == Expanded) {
+                    post(stack[top].first);
+                }
+                stack.pop_back();
+                continue;
+            }
+
+            auto       item     = stack[top].first;
+            const bool expanded = pre(item, push);
+            stack[top]          = { item, expanded ? Expanded : Done };
+            std::reverse(begin(stack) + top + 1, end(stack));
+        }
+    }
+
+private:
+    enum State : std::uint8_t { Reached, Expanded, Done };
+
+    std::vector<std::pair<Item, State>> stack;
+};
@@ -0,0 +1,242 @@
+#include "profile.h"
+#include "threadpool.h"
+#include "truthtable.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+TruthTable::TruthTable(const ExpressionStore &store, std::vector<AtomId> atoms, const std::vector<ExprId> &roots)
+    : atoms(std::move(atoms))
+{
+    std::unordered_map<AtomId, std::uint32_t> column;
+    for (std::uint32_t i = 0; i < this->atoms.size(); i++) {
+        column[this->atoms[i]] = i;
+    }
+
+    // Ids are a topological order, so the reachable nodes sorted by id form a program in
+    // which every operand is computed before it is used.
+    std::vector<ExprId> reachable;
+    std::vector<bool>   seen(store.size());
+    for (const auto r : roots) {
+        store.visit(r, [&](ExprId e, const Expression &) {
+            if (seen[e]) {
+                return false;
+            }
+            seen[e] = true;
+            reachable.push_back(e);
+            return true;
+        });
+    }
+    std::sort(begin(reachable), end(reachable));
+
+    std::vector<std::uint32_t> slot(store.size());
+    for (std::uint32_t i = 0; i < reachable.size(); i++) {
+        const auto &node = store[reachable[i]];
+        slot[reachable[i]] = i;
+        switch (node.op) {
+        case Expression::Pred:
+            program.push_back({ node.op, column[node.lhs], 0 });
+            break;
+        case Expression::Constant:
+            program.push_back({ node.op, node.lhs, 0 });
+            break;
+        case Expression::Neg:
+            program.push_back({ node.op, slot[node.lhs], 0 });
+            break;
+        default:
+            program.push_back({ node.op, slot[node.lhs], slot[node.rhs] });
+            break;
+        }
+    }
+
+    values.resize(program.size());
+    for (const auto r : roots) {
+        rootslots.push_back(slot[r]);
+    }
+}
+
+void TruthTable::eval(std::uint64_t block)
+{
+    // Bit pattern of a column whose row bit lies inside a word
+    static constexpr std::uint64_t patterns[] = { 0xAAAAAAAAAAAAAAAAull, 0xCCCCCCCCCCCCCCCCull, 0xF0F0F0F0F0F0F0F0ull,
+                                                  0xFF00FF00FF00FF00ull, 0xFFFF0000FFFF0000ull, 0xFFFFFFFF00000000ull };
+
+    const auto n = atoms.size();
+    for (std::size_t i = 0; i < program.size(); i++) {
+        const auto &ins = program[i];
+        auto &      out = values[i];
+
+        switch (ins.op) {
+        case Expression::And:
+            for (std::size_t k = 0; k < Lanes; k++) {
+                out[k] = values[ins.a][k] & values[ins.b][k];
+            }
+            break;
+        case Expression::Or:
+            for (std::size_t k = 0; k < Lanes; k++) {
+                out[k] = values[ins.a][k] | values[ins.b][k];
+            }
+            break;
+        case Expression::Impl:
+            for (std::size_t k = 0; k < Lanes; k++) {
+                out[k] = ~values[ins.a][k] | values[ins.b][k];
+            }
+            break;
+        case Expression::BiImpl:
+            for (std::size_t k = 0; k < Lanes; k++) {
+                out[k] = ~(values[ins.a][k] ^ values[ins.b][k]);
+            }
+            break;
+        case Expression::Neg:
+            for (std::size_t k = 0; k < Lanes; k++) {
+                out[k] = ~values[ins.a][k];
+            }
+            break;
+        case Expression::Constant:
+            out.fill(ins.a ? ~std::uint64_t(0) : 0);
+            break;
+        case Expression::Pred: {
+            const auto bit = n - 1 - ins.a;
+            for (std::size_t k = 0; k < Lanes; k++) {
+                const auto word = block * Lanes + k;
+                out[k]          = bit < 6 ? patterns[bit] : ((word >> (bit - 6)) & 1) ? ~std::uint64_t(0) : 0;
+            }
+            break;
+        }
+        }
+    }
+}
+
+// Evaluates chunks of rows on the shared pool, handing the results to consume in chunk order
+template<typename Work, typename Consume>
+static void for_each_chunk(std::uint64_t chunks, Work work, Consume consume)
+{
+    auto &                                          pool = ThreadPool::shared();
+    std::deque<std::future<decltype(work(0ull))>> pending;
+
+    for (std::uint64_t next = 0; next < chunks || !pending.empty();) {
+        // Bounded lookahead keeps the memory constant
+        while (next < chunks && pending.size() < 4 * pool.size()) {
+            pending.push_back(pool.submit([work, chunk = next++] { return work(chunk); }));
+        }
+        consume(pending.front().get());
+        pending.pop_front();
+    }
+}
+
+void print_table(ExpressionStore &store, ExprId expr, TableRows rows, FILE *out)
+{
+    // 1. Get the atoms
+    // 2. evaluate the table chunk by chunk and print the rows
+    // Assuming only up to depth 2
+    auto columns = store.atoms(expr);
+    std::sort(begin(columns), end(columns), [&store](AtomId a, AtomId b) { return store.name(a) < store.name(b); }); // columns ordered by name
+
+    if (columns.size() >= 64) {
+        fprintf(out, "Too many atoms for a table: %zu\n", columns.size());
+        return;
+    }
+    ProfileScope scope("table");
+    scope.counter("rows", std::uint64_t{ 1 } << columns.size());
+
+    if (rows == TableRows::Count) {
+        const TruthTable table(store, std::move(columns), { expr });
+        const auto       chunkblocks = std::max<std::uint64_t>(1, (1 << 20) / TruthTable::BlockRows);
+        const auto       chunks      = (table.blocks() + chunkblocks - 1) / chunkblocks;
+
+        std::uint64_t count = 0;
+        for_each_chunk(
+            chunks,
+            [&table, chunkblocks](std::uint64_t chunk) {
+                auto          local = table;
+                std::uint64_t tt    = 0;
+                const auto    last  = std::min(local.blocks(), (chunk + 1) * chunkblocks);
+                for (auto block = chunk * chunkblocks; block < last; block++) {
+                    local.eval(block);
+                    const auto valid = std::min<std::uint64_t>(TruthTable::BlockRows, local.rows() - block * TruthTable::BlockRows);
+                    for (std::size_t k = 0; k < TruthTable::Lanes && 64 * k < valid; k++) {
+                        const auto mask = valid - 64 * k >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << (valid - 64 * k)) - 1;
+                        tt += __builtin_popcountll(local.result(0)[k] & mask);
+                    }
+                }
+                return tt;
+            },
+            [&count](std::uint64_t tt) { count += tt; });
+
+        store.print(expr, out);
+        fprintf(out, " ⇒ %llu of %llu rows tt\n", static_cast<unsigned long long>(count), static_cast<unsigned long long>(table.rows()));
+        return;
+    }
+
+    // Every cell is " | " followed by tt or ff right aligned to the width of its column
+    std::vector<std::string> cells[2];
+    const auto               addcolumn = [&cells](int width) {
+        for (int value = 0; value < 2; value++) {
+            cells[value].push_back(" | " + std::string(std::max(width - 2, 0), ' ') + (value ? "tt" : "ff"));
+        }
+    };
+
+    for (auto &&a : columns) {
+        fprintf(out, " | %2s", store.name(a).c_str());
+        addcolumn(static_cast<int>(store.name(a).length()));
+    }
+
+    auto roots = store.childs(expr);
+    for (auto &&c : roots) {
+        fprintf(out, " | ");
+        const auto count = store.print(c, out);
+        addcolumn(count);
+
+        for (int i = 2 - count; i > 0; i--) {
+            fprintf(out, " ");
+        }
+    }
+
+    fprintf(out, " | ");
+    addcolumn(store.print(expr, out));
+    roots.push_back(expr);
+
+    fprintf(out, " |\n");
+
+    const TruthTable table(store, std::move(columns), roots);
+    const auto       chunkblocks = std::max<std::uint64_t>(1, (1 << 14) / TruthTable::BlockRows);
+    const auto       chunks      = (table.blocks() + chunkblocks - 1) / chunkblocks;
+
+    for_each_chunk(
+        chunks,
+        [&table, &cells, rows, chunkblocks](std::uint64_t chunk) {
+            auto        local = table;
+            std::string text;
+            const auto  last = std::min(local.blocks(), (chunk + 1) * chunkblocks);
+            for (auto block = chunk * chunkblocks; block < last; block++) {
+                local.eval(block);
+
+                const auto first = block * TruthTable::BlockRows;
+                const auto count = std::min<std::uint64_t>(TruthTable::BlockRows, local.rows() - first);
+                for (std::size_t r = 0; r < count; r++) {
+                    const bool value = TruthTable::row(local.result(local.roots() - 1), r);
+                    if ((rows == TableRows::Satisfying && !value) || (rows == TableRows::Falsifying && value)) {
+                        continue;
+                    }
+
+                    // The atoms
+                    const auto n = local.columns();
+                    for (std::size_t i = 0; i < n; i++) {
+                        text += cells[((first + r) >> (n - 1 - i)) & 1][i];
+                    }
+
+                    // 1. level depth and the expression itself
+                    for (std::size_t c = 0; c < local.roots(); c++) {
+                        text += cells[TruthTable::row(local.result(c), r)][n + c];
+                    }
+
+                    text += " |\n";
+                }
+            }
+            return text;
+        },
+        [out](const std::string &text) { fwrite(text.data(), 1, text.size(), out); });
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "ast.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+enum class TableRows { All, Satisfying, Falsifying, Count };
+
+// Evaluates expressions over all assignments of a list of atoms, 64 rows per word and
+// Lanes words per block. Atom i is column i of the table, the first atom changes slowest,
+// so row r assigns atoms[i] the bit (n - 1 - i) of r.
+//
+// The inner loops work on whole blocks and are vectorized by the compiler, with AVX2 or
+// AVX-512 enabled (SATSOLVER_NATIVE) a block holds 256 resp. 512 rows.
+class TruthTable {
+public:
+#if defined(__AVX512F__)
+    static constexpr std::size_t Lanes = 8;
+#elif defined(__AVX2__)
+    static constexpr std::size_t Lanes = 4;
+#else
+    static constexpr std::size_t Lanes = 1;
+#endif
+    static constexpr std::size_t BlockRows = 64 * Lanes;
+
+    using Block = std::array<std::uint64_t, Lanes>;
+
+    TruthTable(const ExpressionStore &store, std::vector<AtomId> atoms, const std::vector<ExprId> &roots);
+
+    std::size_t   columns() const { return atoms.size(); }
+    std::size_t   roots() const { return rootslots.size(); }
+    std::uint64_t rows() const { return std::uint64_t(1) << atoms.size(); }
+    std::uint64_t blocks() const { return (rows() + BlockRows - 1) / BlockRows; }
+
+    // Evaluates all roots on the rows of the given block
+    void eval(std::uint64_t block);
+
+    // Row bits of roots[i] in the last evaluated block
+    const Block &result(std::size_t i) const { return values[rootslots[i]]; }
+
+    static bool row(const Block &b, std::size_t r) { return (b[r / 64] >> (r % 64)) & 1; }
+
+private:
+    struct Instruction {
+        Expression::Type op;
+        std::uint32_t    a, b; // slots of the operands, column of an atom, value of a constant
+    };
+
+    std::vector<AtomId>        atoms;
+    std::vector<Instruction>   program;
+    std::vector<Block>         values;
+    std::vector<std::uint32_t> rootslots;
+};
+
+// Prints the truth table of expr with a column for each atom and each direct subexpression,
+// or only the rows selected by rows. Count only prints how many rows satisfy expr.
+// Chunks of rows are evaluated and formatted on the shared thread pool and written in order,
+// memory use does not depend on the number of rows.
+void print_table(ExpressionStore &store, ExprId expr, TableRows rows = TableRows::All, FILE *out = stdout);